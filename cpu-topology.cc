@@ -0,0 +1,133 @@
+/**
+ * File: cpu-topology.cc
+ * ---------------------
+ * Presents the implementation of the CPU topology and placement functions exported by cpu-topology.h.
+ */
+
+#include "cpu-topology.h"
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+#include <cstdlib>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+using namespace std;
+
+static const string kCPUDirectory = "/sys/devices/system/cpu/cpu";
+
+/**
+ * Function: readTopologyValue
+ * ---------------------------
+ * Reads the integer in /sys/devices/system/cpu/cpu<cpu>/topology/<name>, returning
+ * the supplied fallback if the file doesn't exist or doesn't hold an integer.
+ */
+static int readTopologyValue(int cpu, const string& name, int fallback) {
+  ifstream infile(kCPUDirectory + to_string(cpu) + "/topology/" + name);
+  int value;
+  if (!(infile >> value)) return fallback;
+  return value;
+}
+
+/**
+ * Function: findNode
+ * ------------------
+ * Each CPU's sysfs directory contains a link named node<n> for the NUMA node it belongs to.
+ */
+static int findNode(int cpu) {
+  DIR *dir = opendir((kCPUDirectory + to_string(cpu)).c_str());
+  if (dir == NULL) return 0;
+  int node = 0;
+  while (struct dirent *entry = readdir(dir)) {
+    string name = entry->d_name;
+    if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+        name.find_first_not_of("0123456789", 4) == string::npos) {
+      node = atoi(name.c_str() + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+void collectAllowedCPUs(vector<cpuInfo>& cpus) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+    long numOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < numOnline && cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &allowed);
+  }
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) continue;
+    cpuInfo info = {cpu, findNode(cpu), readTopologyValue(cpu, "physical_package_id", 0), readTopologyValue(cpu, "core_id", cpu)};
+    cpus.push_back(info);
+  }
+}
+
+static bool sameCore(const cpuInfo& one, const cpuInfo& two) {
+  return one.package == two.package && one.core == two.core;
+}
+
+static bool byNodeAndCore(const cpuInfo& one, const cpuInfo& two) {
+  if (one.node != two.node) return one.node < two.node;
+  if (one.package != two.package) return one.package < two.package;
+  if (one.core != two.core) return one.core < two.core;
+  return one.cpu < two.cpu;
+}
+
+/**
+ * Function: spreadAcrossNodes
+ * ---------------------------
+ * Given CPUs sorted by node and core, ranks each one by how many of its siblings precede it,
+ * orders each node's CPUs by rank (so every core is used once before any is used twice), and
+ * then deals the nodes' CPUs out round robin.
+ */
+static void spreadAcrossNodes(const vector<cpuInfo>& sorted, vector<cpuInfo>& placement) {
+  vector<vector<pair<int, cpuInfo>>> nodes;
+  int rank = 0;
+  for (size_t i = 0; i < sorted.size(); i++) {
+    if (i == 0 || sorted[i].node != sorted[i - 1].node) nodes.push_back(vector<pair<int, cpuInfo>>());
+    rank = i > 0 && sameCore(sorted[i], sorted[i - 1]) ? rank + 1 : 0;
+    nodes.back().push_back(make_pair(rank, sorted[i]));
+  }
+
+  for (vector<pair<int, cpuInfo>>& node: nodes)
+    stable_sort(node.begin(), node.end(), [](const pair<int, cpuInfo>& one, const pair<int, cpuInfo>& two) {
+      return one.first < two.first;
+    });
+  for (size_t round = 0; placement.size() < sorted.size(); round++) {
+    for (const vector<pair<int, cpuInfo>>& node: nodes)
+      if (round < node.size()) placement.push_back(node[round].second);
+  }
+}
+
+void planPlacement(const vector<cpuInfo>& cpus, placementPolicy policy, vector<cpuInfo>& placement) {
+  vector<cpuInfo> sorted = cpus;
+  sort(sorted.begin(), sorted.end(), byNodeAndCore);
+  switch (policy) {
+  case kFillSMT:
+    placement = sorted;
+    break;
+  case kOnePerCore:
+    for (size_t i = 0; i < sorted.size(); i++)
+      if (i == 0 || !sameCore(sorted[i], sorted[i - 1])) placement.push_back(sorted[i]);
+    break;
+  case kSpreadNodes:
+    spreadAcrossNodes(sorted, placement);
+    break;
+  }
+}
+
+void countDistinct(const vector<cpuInfo>& cpus, size_t& numCores, size_t& numNodes) {
+  set<pair<int, int>> cores;
+  set<int> nodes;
+  for (const cpuInfo& info: cpus) {
+    cores.insert(make_pair(info.package, info.core));
+    nodes.insert(info.node);
+  }
+  numCores = cores.size();
+  numNodes = nodes.size();
+}
@@ -0,0 +1,65 @@
+/**
+ * File: cpu-topology.h
+ * --------------------
+ * Exports what farm needs to decide where its workers should run: the CPUs the process is
+ * allowed to use (per sched_getaffinity, which honors taskset and cgroup cpusets), each CPU's
+ * place in the machine (per /sys/devices/system/cpu), and placement policies built on both.
+ */
+
+#pragma once
+#include <vector>
+#include <cstddef>
+
+/**
+ * Type: cpuInfo
+ * -------------
+ * Describes one logical CPU.  Two CPUs with the same package and core are SMT siblings.
+ * node is the CPU's NUMA node (0 on machines without NUMA).
+ */
+struct cpuInfo {
+  int cpu;
+  int node;
+  int package;
+  int core;
+};
+
+/**
+ * Type: placementPolicy
+ * ---------------------
+ * kFillSMT uses every allowed CPU, placing workers on all the siblings of one core before
+ * moving on to the next, so that neighboring workers share caches.
+ * kOnePerCore uses just one CPU of each physical core, leaving its siblings idle.
+ * kSpreadNodes uses every allowed CPU, but alternates between NUMA nodes (and, within a
+ * node, uses every core once before doubling up on any of them), so that any prefix of
+ * the placement is spread as widely as possible.
+ */
+enum placementPolicy {
+  kFillSMT,
+  kOnePerCore,
+  kSpreadNodes
+};
+
+/**
+ * Function: collectAllowedCPUs
+ * ----------------------------
+ * Populates the supplied vector with every CPU the calling process may run on, in
+ * increasing order.  Topology that sysfs doesn't report is filled in as if each
+ * CPU were its own core on node 0.
+ */
+void collectAllowedCPUs(std::vector<cpuInfo>& cpus);
+
+/**
+ * Function: planPlacement
+ * -----------------------
+ * Populates placement with the CPUs to pin workers to, in the order they should be
+ * used, according to the supplied policy.  The placement's size is the number of
+ * workers the policy calls for.
+ */
+void planPlacement(const std::vector<cpuInfo>& cpus, placementPolicy policy, std::vector<cpuInfo>& placement);
+
+/**
+ * Function: countDistinct
+ * -----------------------
+ * Counts the distinct physical cores and NUMA nodes among the supplied CPUs.
+ */
+void countDistinct(const std::vector<cpuInfo>& cpus, size_t& numCores, size_t& numNodes);
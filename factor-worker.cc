@@ -0,0 +1,80 @@
+/**
+ * File: factor-worker.cc
+ * ----------------------
+ * Presents the implementation of factor-worker, a native replacement for factor.py that speaks
+ * precisely the same protocol: it reads numbers from stdin, one per line, and publishes each
+ * one's factorization to stdout as with
+ *
+ *    1000001 = 101 * 9901 [pid: 1234, time: 2.1e-06 seconds]
+ *
+ * With --self-halting, it stops itself before reading each number (or, with --batched, each
+ * batch of numbers preceded by the size of the batch), which is how farm learns it's ready for more.
+ * The factoring itself is done by the kernel in factorization.cc.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <csignal>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "factorization.h"
+using namespace std;
+
+/**
+ * Function: readNumber
+ * --------------------
+ * Reads the next number from stdin, returning false at the end of the input or
+ * if the next line isn't a 64-bit integer.
+ */
+static bool readNumber(long long& num) {
+  string line;
+  if (!getline(cin, line)) return false;
+  char *end;
+  errno = 0;
+  num = strtoll(line.c_str(), &end, 10);
+  return errno == 0 && end != line.c_str();
+}
+
+// farm never sends a batch larger than its own kMaxBatchSize, so a larger (or nonpositive)
+// count can only mean the input is garbled, and ends it just as a bad number does.
+static const long long kMaxBatchSize = 1024;
+
+static const string kSelfHaltingFlag = "--self-halting";
+static const string kBatchedFlag = "--batched";
+int main(int argc, char *argv[]) {
+  prctl(PR_SET_PDEATHSIG, SIGKILL); // don't leave stopped workers behind if farm goes away
+  bool selfHalting = false, batched = false;
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == kSelfHaltingFlag) selfHalting = true;
+    else if (argv[i] == kBatchedFlag) batched = true;
+  }
+
+  if (!loadPrimeTable()) {
+    cerr << argv[0] << ": Failed to build the table of primes." << endl;
+    return 1;
+  }
+
+  pid_t pid = getpid();
+  while (true) {
+    if (selfHalting) raise(SIGSTOP);
+    long long count = 1;
+    if (batched && (!readNumber(count) || count < 1 || count > kMaxBatchSize)) break;
+    vector<long long> nums(count);
+    bool done = false;
+    for (long long& num: nums) done = done || !readNumber(num);
+    if (done) break;
+    for (long long num: nums) {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      string response = factorization(num);
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      printf("%s [pid: %d, time: %g seconds]\n", response.c_str(), pid, seconds);
+    }
+    fflush(stdout); // farm collects results over a pipe, so each batch has to be pushed out right away
+  }
+  return 0;
+}
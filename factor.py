@@ -26,14 +26,22 @@ def factorization(num):
     factors = map(lambda num: str(num), factors)
     return '%d = %s' % (original, ' * '.join(factors))
 
-self_halting = len(sys.argv) > 1 and sys.argv[1] == '--self-halting'
+# With --batched, each batch of numbers is preceded by a line with the size of the batch,
+# and a self-halting worker only stops (signaling it's ready for more) once it's published
+# the results for the entire batch.
+self_halting = '--self-halting' in sys.argv[1:]
+batched = '--batched' in sys.argv[1:]
 pid = os.getpid()
 while True:
     if self_halting: os.kill(pid, signal.SIGSTOP)
-    try: num = int(raw_input())
+    try:
+        count = int(raw_input()) if batched else 1
+        nums = [int(raw_input()) for i in xrange(count)]
     except EOFError: break;
-    start = time.time()
-    response = factorization(num)
-    stop = time.time()
-    print '%s [pid: %d, time: %g seconds]' % (response, pid, stop - start)
+    for num in nums:
+        start = time.time()
+        response = factorization(num)
+        stop = time.time()
+        print '%s [pid: %d, time: %g seconds]' % (response, pid, stop - start)
+    sys.stdout.flush() # farm collects results over a pipe, so each batch has to be pushed out right away
     
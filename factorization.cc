@@ -0,0 +1,254 @@
+/**
+ * File: factorization.cc
+ * ----------------------
+ * Presents the implementation of the factoring kernel shared by factor-worker and farm --threads.
+ * Small factors are found by trial division using a table of primes built by a segmented sieve.
+ * The table is stored in a file (kSieveFilename) that's built by whichever process first finds it
+ * missing, and every process maps it read-only so they all share one copy.  Whatever trial division
+ * leaves behind is proven prime by a deterministic Miller-Rabin test or split by Pollard's rho
+ * (with Brent's cycle detection), so even the hardest 64-bit inputs (products of two 32-bit primes)
+ * take about a millisecond.
+ */
+
+#include "factorization.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+/**
+ * Constants: kSieveFilename, kSieveMagic, kSieveLimit, kSieveSegmentSize, kTrialDivisionLimit
+ * -------------------------------------------------------------------------------------------
+ * kSieveFilename names the file holding all primes below kSieveLimit, which is built kSieveSegmentSize
+ * numbers at a time so the sieve itself stays in cache.  Only primes below kTrialDivisionLimit are
+ * used for trial division; the rest of the table answers primality questions about small numbers.
+ */
+static const string kSieveFilename = ".factor_sieve.bin";
+static const char kSieveMagic[8] = {'F', 'A', 'C', 'T', 'S', 'I', 'E', 'V'};
+static const uint32_t kSieveLimit = 1 << 20;
+static const uint32_t kSieveSegmentSize = 1 << 15;
+static const uint32_t kTrialDivisionLimit = 1 << 12;
+
+/**
+ * Type: sieveHeader
+ * -----------------
+ * Leads off kSieveFilename, and is followed immediately by numPrimes uint32_t primes in increasing order.
+ */
+struct sieveHeader {
+  char magic[8];
+  uint32_t limit;
+  uint32_t numPrimes;
+};
+
+/**
+ * Function: sievePrimes
+ * ---------------------
+ * Appends all primes below kSieveLimit to the supplied vector.  The primes up to sqrt(kSieveLimit)
+ * are found with a simple sieve, and are then used to cross off composites one segment at a time.
+ */
+static void sievePrimes(vector<uint32_t>& primes) {
+  uint32_t root = 1;
+  while (root * root < kSieveLimit) root++;
+  vector<bool> small(root + 1, true);
+  vector<uint32_t> basePrimes;
+  for (uint32_t n = 2; n <= root; n++) {
+    if (!small[n]) continue;
+    basePrimes.push_back(n);
+    for (uint32_t m = n * n; m <= root; m += n) small[m] = false;
+  }
+
+  vector<bool> segment(kSieveSegmentSize);
+  for (uint32_t low = 0; low < kSieveLimit; low += kSieveSegmentSize) {
+    uint32_t high = min(low + kSieveSegmentSize, kSieveLimit);
+    fill(segment.begin(), segment.end(), true);
+    for (uint32_t p: basePrimes) {
+      if (p * p >= high) break;
+      uint32_t first = max(p * p, (low + p - 1) / p * p);
+      for (uint32_t m = first; m < high; m += p) segment[m - low] = false;
+    }
+    for (uint32_t n = max(low, 2U); n < high; n++)
+      if (segment[n - low]) primes.push_back(n);
+  }
+}
+
+/**
+ * Function: writeSieveFile
+ * ------------------------
+ * Builds the table of primes and writes it to kSieveFilename by way of a temporary file,
+ * so that other workers never map a partially written table.
+ */
+static void writeSieveFile() {
+  vector<uint32_t> primes;
+  sievePrimes(primes);
+  sieveHeader header;
+  memcpy(header.magic, kSieveMagic, sizeof(kSieveMagic));
+  header.limit = kSieveLimit;
+  header.numPrimes = primes.size();
+  string temporaryFilename = kSieveFilename + "." + to_string(getpid());
+  FILE *outfile = fopen(temporaryFilename.c_str(), "wb");
+  if (outfile == NULL) return;
+  bool written = fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+                 fwrite(primes.data(), sizeof(uint32_t), primes.size(), outfile) == primes.size();
+  if (fclose(outfile) != 0 || !written || rename(temporaryFilename.c_str(), kSieveFilename.c_str()) == -1)
+    unlink(temporaryFilename.c_str());
+}
+
+/**
+ * Function: mapSieveFile
+ * ----------------------
+ * Maps kSieveFilename, if it exists and is complete, and surfaces the primes it holds.
+ */
+static bool mapSieveFile(const uint32_t *& primes, size_t& numPrimes) {
+  int fd = open(kSieveFilename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(sieveHeader))
+    mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+  const sieveHeader *header = static_cast<const sieveHeader *>(mapping);
+  if (memcmp(header->magic, kSieveMagic, sizeof(kSieveMagic)) != 0 || header->limit != kSieveLimit ||
+      size_t(st.st_size) != sizeof(sieveHeader) + size_t(header->numPrimes) * sizeof(uint32_t)) {
+    munmap(mapping, st.st_size);
+    return false;
+  }
+  primes = reinterpret_cast<const uint32_t *>(header + 1);
+  numPrimes = header->numPrimes;
+  return true;
+}
+
+static const uint32_t *primes;
+static size_t numPrimes;
+
+static uint64_t multiplyModulo(uint64_t a, uint64_t b, uint64_t m) {
+  return uint64_t(uint128_t(a) * b % m);
+}
+
+static uint64_t powerModulo(uint64_t base, uint64_t exponent, uint64_t m) {
+  uint64_t result = 1;
+  base %= m;
+  while (exponent > 0) {
+    if (exponent & 1) result = multiplyModulo(result, base, m);
+    base = multiplyModulo(base, base, m);
+    exponent >>= 1;
+  }
+  return result;
+}
+
+/**
+ * Function: isPrime
+ * -----------------
+ * Small numbers are looked up in the table of primes.  Everything else is subjected to
+ * Miller-Rabin with the first twelve primes as bases, which is deterministic for all 64-bit numbers.
+ */
+static const uint64_t kMillerRabinBases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+static bool isPrime(uint64_t n) {
+  if (n < kSieveLimit) return binary_search(primes, primes + numPrimes, uint32_t(n));
+  uint64_t d = n - 1;
+  int s = 0;
+  while ((d & 1) == 0) {
+    d >>= 1;
+    s++;
+  }
+
+  for (uint64_t a: kMillerRabinBases) {
+    uint64_t x = powerModulo(a, d, n);
+    if (x == 1 || x == n - 1) continue;
+    bool composite = true;
+    for (int r = 1; r < s && composite; r++) {
+      x = multiplyModulo(x, x, n);
+      if (x == n - 1) composite = false;
+    }
+    if (composite) return false;
+  }
+  return true;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/**
+ * Function: findDivisor
+ * ---------------------
+ * Finds a nontrivial divisor of the odd composite n using Pollard's rho with Brent's cycle
+ * detection, batching the gcds so that only one is computed every kBatch steps.  Should a
+ * walk collapse onto n itself, it's retried with a different polynomial.
+ */
+static uint64_t findDivisor(uint64_t n) {
+  static const uint64_t kBatch = 128;
+  for (uint64_t c = 1; ; c++) {
+    uint64_t y = 2, x = 2, ys = 2, q = 1, g = 1;
+    for (uint64_t r = 1; g == 1; r <<= 1) {
+      x = y;
+      for (uint64_t i = 0; i < r; i++) y = (multiplyModulo(y, y, n) + c) % n;
+      for (uint64_t k = 0; k < r && g == 1; k += kBatch) {
+        ys = y;
+        for (uint64_t i = 0; i < min(kBatch, r - k); i++) {
+          y = (multiplyModulo(y, y, n) + c) % n;
+          q = multiplyModulo(q, x > y ? x - y : y - x, n);
+        }
+        g = gcd(q, n);
+      }
+    }
+
+    if (g == n) {
+      do {
+        ys = (multiplyModulo(ys, ys, n) + c) % n;
+        g = gcd(x > ys ? x - ys : ys - x, n);
+      } while (g == 1);
+    }
+    if (g != n) return g;
+  }
+}
+
+static void collectFactors(uint64_t n, vector<uint64_t>& factors) {
+  if (n == 1) return;
+  if (isPrime(n)) {
+    factors.push_back(n);
+    return;
+  }
+  uint64_t d = findDivisor(n);
+  collectFactors(d, factors);
+  collectFactors(n / d, factors);
+}
+
+string factorization(long long num) {
+  if (num == 1) return "1 = 1";
+  string response = to_string(num) + " =";
+  if (num < 2) return response + " ";
+
+  vector<uint64_t> factors;
+  uint64_t n = num;
+  for (size_t i = 0; i < numPrimes && primes[i] < kTrialDivisionLimit && uint64_t(primes[i]) * primes[i] <= n; i++) {
+    while (n % primes[i] == 0) {
+      factors.push_back(primes[i]);
+      n /= primes[i];
+    }
+  }
+  collectFactors(n, factors);
+  sort(factors.begin(), factors.end());
+  for (size_t i = 0; i < factors.size(); i++) response += (i == 0 ? " " : " * ") + to_string(factors[i]);
+  return response;
+}
+
+bool loadPrimeTable() {
+  if (mapSieveFile(primes, numPrimes)) return true;
+  writeSieveFile();
+  return mapSieveFile(primes, numPrimes);
+}
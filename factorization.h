@@ -0,0 +1,27 @@
+/**
+ * File: factorization.h
+ * ---------------------
+ * Exports the factoring kernel behind factor-worker, which farm --threads also links in directly.
+ */
+
+#pragma once
+#include <string>
+
+/**
+ * Function: loadPrimeTable
+ * ------------------------
+ * Maps the table of small primes used for trial division, building it first if need be.
+ * Must be called (and must succeed) before factorization is; returns false if the table
+ * can't be built.  Once loaded, the table is read-only, so factorization may be called
+ * from any number of threads at once.
+ */
+bool loadPrimeTable();
+
+/**
+ * Function: factorization
+ * -----------------------
+ * Returns the same text factor.py's factorization function would (e.g. "12 = 2 * 2 * 3"),
+ * including for the numbers below 2, which factor.py reports as having no factors at all
+ * (except for 1, which it reports as 1).
+ */
+std::string factorization(long long num);
@@ -1,127 +1,710 @@
 #include <cassert>
 #include <ctime>
 #include <cctype>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <cstdlib>
 #include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include "subprocess.h"
+#include "mpmc-queue.h"
+#include "factorization.h"
+#include "cpu-topology.h"
 #include "fork-utils.h"  // this has to be the last #include'd statement in the file
 
 using namespace std;
 
+// Every number read from stdin becomes a job, identified by its (one-based) line number.
+// attempts counts how many times the job has been dispatched, so that a number that keeps
+// killing its workers is eventually given up on.
+struct job {
+  size_t id;
+  long long number;
+  size_t attempts;
+};
+
+// Each worker publishes its results over its own pipe (sp.ingestfd), one line per number, in
+// the order the numbers were sent.  inFlight holds the jobs the worker owes results for, and
+// partialOutput holds any incomplete line read from the pipe so far.  batchSize and dispatched
+// describe the batch the worker is currently working through (if any), so that its per-job
+// latency can be measured when it stops to ask for more, and idleSince records when it last
+// stopped.  A worker's slot can only be reused once the worker has been reaped (alive is false)
+// and everything it published has been read (outputOpen is false).
 struct worker {
-  worker() {}
-  worker(char *argv[]) : sp(subprocess(argv, true, false)), available(false) {}
+  worker() : alive(false), outputOpen(false), starting(false), retiring(false), batchSize(0) {}
+  worker(char *argv[]) : sp(subprocess(argv, true, true)), alive(true), outputOpen(true), starting(true), retiring(false), batchSize(0) {}
   subprocess_t sp;
-  bool available;
+  bool alive;
+  bool outputOpen;
+  bool starting;
+  bool retiring;
+  deque<job> inFlight;
+  string partialOutput;
+  size_t batchSize;
+  chrono::steady_clock::time_point dispatched;
+  chrono::steady_clock::time_point idleSince;
+};
+
+// The worker in slot i is pinned to placement[i].cpu.  The placement is planned from the CPUs farm
+// itself is allowed to run on (so it respects taskset and cgroup cpusets) and their topology,
+// according to the --placement policy, and its size is the most workers there can be.
+static placementPolicy policy = kFillSMT;
+static vector<cpuInfo> placement;
+static vector<worker> workers;
+static unordered_map<pid_t, size_t> workerIndices;
+static unordered_map<int, size_t> workerOutputs;
+static size_t numWorkersAlive = 0;
+static size_t numWorkersStarting = 0;
+static size_t numWorkersRetiring = 0;
+
+// Workers stop themselves whenever they're ready for another number, and the SIGCHLD
+// reporting each stop pushes the worker onto the back of this queue, so dispatch never
+// has to search for an idle worker.  Dispatch takes the most recently stopped worker from
+// the back, so that the workers at the front are the ones that have been idle longest.
+static deque<size_t> availableWorkers;
+
+// The pool starts with minWorkers workers and grows, up to maxWorkers, whenever jobs are
+// waiting and every worker is busy (doubling each time the workers it last added have come
+// up).  A worker that sits idle for kIdleTimeout is retired, unless that would leave fewer
+// than minWorkers.  A worker that exits on its own is replaced as needed, and the jobs it
+// owed results for are dispatched again, up to kMaxAttempts times apiece.  Should workers
+// die kMaxConsecutiveCrashes times without a single result in between, they're presumed
+// unable to start at all, and no more are spawned.
+static size_t minWorkers = 1;
+static size_t maxWorkers = 0; // 0 means as many as the placement allows
+static const chrono::milliseconds kIdleTimeout(1000);
+static const size_t kMaxAttempts = 3;
+static const size_t kMaxConsecutiveCrashes = 8;
+static size_t numConsecutiveCrashes = 0;
+
+// Jobs read from stdin but not yet dispatched.  stdin is only read when it has something
+// to offer, and reading pauses while this many jobs are pending.
+static deque<job> pendingJobs;
+static const size_t kMaxPendingJobs = 1 << 16;
+static size_t numJobsRead = 0;
+static size_t numJobsOutstanding = 0;
+
+// Results are published either as soon as they arrive (kCompletionOrder) or in input order
+// (kInputOrder), in which case results that arrive early wait in completedResults.  At most
+// kReorderWindow jobs are dispatched beyond the oldest one still unpublished, which bounds
+// how many results can be waiting.
+enum resultOrder {
+  kCompletionOrder,
+  kInputOrder
 };
+static resultOrder order = kCompletionOrder;
+static map<size_t, string> completedResults;
+static size_t nextResultToPublish = 1;
+static const size_t kReorderWindow = 4096;
+
+// Each time a worker is woken up it's handed a batch of up to batchSize numbers, and it
+// stops again once it's factored all of them.  With --batch=auto, the batch size is chosen
+// so that each batch takes roughly kTargetBatchSeconds, based on a moving average of the
+// per-job latencies measured so far, but no worker is handed more than its share of the
+// pending jobs so that the last of them are still spread across all workers.
+static size_t batchSize = 1;
+static bool adaptiveBatching = false;
+static double averageJobSeconds = 0;
+static const size_t kMaxBatchSize = 1024; // keeps each batch well within the capacity of a pipe
+static const double kTargetBatchSeconds = 0.01;
+
+static int epollfd = -1;
+static int sigchldfd = -1;
+
+// With --threads, jobs are run by one thread per CPU inside farm itself, by calling jobFunction
+// rather than by writing to a worker process, so nothing is forked, exec'ed, piped, or signaled
+// per job.  Each thread has its own lock-free queue, which the main thread deals jobs into round
+// robin, and a thread whose queue runs dry steals from the others.  Each thread allocates its own
+// queue once it's been pinned, so the queue's memory is first touched on (and so lives on) the
+// thread's NUMA node.  jobsAvailable counts the jobs sitting in all queues, so a thread that gets
+// past it is guaranteed to find one somewhere (and only sleeps in the kernel when there's nothing
+// at all to do).  Results come back over a single queue, and resultfd is signaled only when that
+// queue goes from empty to nonempty.  Process mode remains the default, since it's the only way to
+// run workers that aren't C++ or can't be trusted.
+typedef string (*jobFunction)(long long number);
+struct threadResult {
+  size_t id;
+  string result;
+};
+
+static bool threadMode = false;
+static jobFunction threadJob = factorization;
+static vector<thread> threads;
+static vector<unique_ptr<MPMCQueue<job>>> threadQueues;
+static unique_ptr<MPMCQueue<threadResult>> threadResults;
+static const size_t kThreadQueueCapacity = 1024; // bounds the jobs outstanding, so results always fit
+static size_t nextThreadQueue = 0;
+static sem_t jobsAvailable;
+static sem_t threadsReady;
+static atomic<bool> threadsStopping(false);
+static atomic<long> resultsQueued(0);
+static int resultfd = -1;
+
+static void watchDescriptor(int fd) {
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event);
+}
+
+// Any executable that speaks factor.py's protocol can serve as a worker.  The default is the native
+// factor-worker, but --worker=./factor.py (for instance) brings back the original.
+static string workerExecutable = "./factor-worker";
+static void planWorkerPlacement() {
+  vector<cpuInfo> allowed;
+  collectAllowedCPUs(allowed);
+  planPlacement(allowed, policy, placement);
+  size_t numCores, numNodes;
+  countDistinct(allowed, numCores, numNodes);
+  maxWorkers = maxWorkers == 0 ? placement.size() : min(maxWorkers, placement.size());
+  minWorkers = threadMode ? maxWorkers : min(minWorkers, maxWorkers); // idle threads cost nothing, so that pool is fixed
+  cerr << "There are this many CPUs available: " << allowed.size() << ", on " << numCores << " cores and "
+       << numNodes << (numNodes == 1 ? " node" : " nodes") << ", so there will be between " << minWorkers
+       << " and " << maxWorkers << " workers." << endl;
+}
+
+static void pinToCPU(pid_t pid, const cpuInfo& info) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(info.cpu, &cpus);
+  sched_setaffinity(pid, sizeof(cpu_set_t), &cpus);
+}
+
+// Workers are spawned into the lowest free slot, so the pool favors the front of the
+// placement, whose CPUs are the ones planPlacement prefers.
+//
+// Once watchWorkers has blocked SIGCHLD, it's unblocked while each worker is spawned, so
+// the worker doesn't inherit the blocked mask.  Any stops missed while it was unblocked are
+// picked up by the caller's next call to markWorkersAsAvailable, which always reaps.
+static bool spawnWorker() {
+  size_t i = 0;
+  while (i < maxWorkers && (workers[i].alive || workers[i].outputOpen)) i++;
+  if (i == maxWorkers) return false;
+
+  const char *arguments[] = {workerExecutable.c_str(), "--self-halting", NULL, NULL};
+  if (batchSize != 1 || adaptiveBatching) arguments[2] = "--batched";
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_UNBLOCK, &mask, NULL);
+  bool spawned = true;
+  try {
+    workers[i] = worker(const_cast<char **>(arguments));
+  } catch (const SubprocessException& se) {
+    cerr << "Failed to spawn " << workerExecutable << ": " << se.what() << endl;
+    spawned = false;
+  }
+  if (sigchldfd != -1) sigprocmask(SIG_BLOCK, &mask, NULL);
+  if (!spawned) {
+    numConsecutiveCrashes++;
+    return false;
+  }
+  workerIndices[workers[i].sp.pid] = i;
+  workerOutputs[workers[i].sp.ingestfd] = i;
+  numWorkersAlive++;
+  numWorkersStarting++;
+  pinToCPU(workers[i].sp.pid, placement[i]);
+  if (epollfd != -1) watchDescriptor(workers[i].sp.ingestfd);
+  cerr << "Worker " << workers[i].sp.pid << " is set to run on CPU " << placement[i].cpu
+       << " (node " << placement[i].node << ")." << endl;
+  return true;
+}
+
+static void spawnAllWorkers() {
+  workers.resize(maxWorkers);
+  for (size_t i = 0; i < minWorkers; i++) spawnWorker();
+}
 
-static const size_t kNumCPUs = sysconf(_SC_NPROCESSORS_ONLN);
-static vector<worker> workers(kNumCPUs);
-static size_t numWorkersAvailable = 0;
-
-static void markWorkersAsAvailable(int sig) {
-  while(true) {
-    pid_t pid = waitpid(-1, NULL, WNOHANG|WUNTRACED);
-    if(pid <= 0)  break;
-    for(size_t worker = 0; worker < kNumCPUs; worker++) {
-      if(workers[worker].sp.pid == pid) {
-	workers[worker].available = true;
-	numWorkersAvailable++;
-	break;
+// SIGCHLD is blocked only after the workers have been spawned, so they don't inherit
+// the blocked mask.  Any stops that happened in between are picked up by the first
+// call to markWorkersAsAvailable, which always reaps before returning.
+static void watchWorkers() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  sigchldfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  epollfd = epoll_create1(EPOLL_CLOEXEC);
+  watchDescriptor(sigchldfd);
+  for (const worker& w: workers)
+    if (w.outputOpen) watchDescriptor(w.sp.ingestfd);
+}
+
+static void runJobs(size_t index) {
+  pid_t tid = syscall(SYS_gettid);
+  pinToCPU(tid, placement[index]);
+  threadQueues[index].reset(new MPMCQueue<job>(kThreadQueueCapacity));
+  sem_post(&threadsReady);
+  while (true) {
+    while (sem_wait(&jobsAvailable) == -1 && errno == EINTR);
+    if (threadsStopping.load()) return;
+    job j;
+    for (size_t i = 0; !threadQueues[(index + i) % threadQueues.size()]->pop(j); i++);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string result = threadJob(j.number);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), " [tid: %d, time: %g seconds]", tid, seconds);
+    threadResult r = {j.id, result + suffix};
+    while (!threadResults->push(r)) this_thread::yield();
+    if (resultsQueued++ == 0) {
+      uint64_t one = 1;
+      write(resultfd, &one, sizeof(one));
+    }
+  }
+}
+
+// Threads are placed just as spawnAllWorkers places processes, but each one pins itself.
+static void spawnAllThreads() {
+  sem_init(&jobsAvailable, 0, 0);
+  sem_init(&threadsReady, 0, 0);
+  threadResults.reset(new MPMCQueue<threadResult>(kThreadQueueCapacity));
+  threadQueues.resize(maxWorkers);
+  resultfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  for (size_t i = 0; i < maxWorkers; i++) {
+    threads.push_back(thread(runJobs, i));
+    cerr << "Thread " << i << " is set to run on CPU " << placement[i].cpu << " (node " << placement[i].node << ")." << endl;
+  }
+  for (size_t i = 0; i < threads.size(); i++)
+    while (sem_wait(&threadsReady) == -1 && errno == EINTR);
+  sem_destroy(&threadsReady);
+  numWorkersAlive = threads.size();
+}
+
+static void watchThreads() {
+  epollfd = epoll_create1(EPOLL_CLOEXEC);
+  watchDescriptor(resultfd);
+}
+
+static void recordBatchLatency(worker& w) {
+  if (w.batchSize == 0) return;
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - w.dispatched).count() / w.batchSize;
+  averageJobSeconds = averageJobSeconds == 0 ? seconds : 0.8 * averageJobSeconds + 0.2 * seconds;
+  w.batchSize = 0;
+}
+
+// A worker that exits is taken out of rotation, but any results it published on the way
+// out are still sitting in its pipe, so its in-flight jobs are only dispatched again once
+// publishResults sees the end of the pipe.
+static void markWorkersAsAvailable() {
+  struct signalfd_siginfo info;
+  while (read(sigchldfd, &info, sizeof(info)) > 0);
+  while (true) {
+    int status;
+    pid_t pid = waitpid(-1, &status, WNOHANG | WUNTRACED);
+    if (pid <= 0) break;
+    auto found = workerIndices.find(pid);
+    if (found == workerIndices.end()) continue;
+    worker& w = workers[found->second];
+    if (WIFSTOPPED(status)) {
+      if (w.starting) numWorkersStarting--;
+      w.starting = false;
+      recordBatchLatency(w);
+      w.idleSince = chrono::steady_clock::now();
+      availableWorkers.push_back(found->second);
+    } else {
+      if (!w.retiring) {
+        cerr << "Worker " << pid << " exited unexpectedly." << endl;
+        numConsecutiveCrashes++;
+        close(w.sp.supplyfd);
       }
+      if (w.starting) numWorkersStarting--;
+      if (w.retiring) numWorkersRetiring--;
+      w.alive = false;
+      w.starting = false;
+      numWorkersAlive--;
+      size_t index = found->second;
+      workerIndices.erase(found);
+      availableWorkers.erase(remove(availableWorkers.begin(), availableWorkers.end(), index), availableWorkers.end());
     }
   }
 }
 
-static const char *kWorkerArguments[] = {"./factor.py", "--self-halting", NULL};
-static void spawnAllWorkers() {
-  cout << "There are this many CPUs: " << kNumCPUs << ", numbered 0 through " << kNumCPUs - 1 << "." << endl;
-  for (size_t i = 0; i < kNumCPUs; i++) {
-    cpu_set_t cpus;
-    CPU_ZERO(&cpus);
-    CPU_SET(i, &cpus);
-
-    workers[i] = worker((char**)kWorkerArguments);
-    sched_setaffinity(workers[i].sp.pid, sizeof(cpu_set_t), &cpus);
-    cout << "Worker " << workers[i].sp.pid << " is set to run on CPU " << i << "." << endl;
-  }
-}
-
-static size_t getAvailableWorker() {
-  sigset_t additions, existingmask;
-  sigemptyset(&additions);
-  sigaddset(&additions, SIGCHLD);
-  sigprocmask(SIG_BLOCK, &additions, &existingmask);
-  while(numWorkersAvailable == 0) {
-    sigsuspend(&existingmask);
-  }
-  int availableWorkers = kNumCPUs;
-  for(size_t worker = 0; worker < kNumCPUs; worker++) {
-    if(workers[worker].available) {
-      availableWorkers = worker;
-      break;
+static void publishResult(size_t id, const string& result) {
+  numJobsOutstanding--;
+  numConsecutiveCrashes = 0;
+  if (order == kCompletionOrder) {
+    cout << "[job " << id << "] " << result << '\n';
+    return;
+  }
+
+  completedResults[id] = result;
+  while (!completedResults.empty() && completedResults.begin()->first == nextResultToPublish) {
+    cout << "[job " << nextResultToPublish << "] " << completedResults.begin()->second << '\n';
+    completedResults.erase(completedResults.begin());
+    nextResultToPublish++;
+  }
+}
+
+// Reads whatever the worker has published and matches each complete line with the
+// oldest job the worker owes a result for.
+static void publishResults(size_t index) {
+  worker& w = workers[index];
+  char buffer[1 << 16];
+  ssize_t count = read(w.sp.ingestfd, buffer, sizeof(buffer));
+  if (count == -1 && errno == EINTR) return;
+  if (count > 0) w.partialOutput.append(buffer, count);
+  size_t start = 0;
+  while (true) {
+    size_t newline = w.partialOutput.find('\n', start);
+    if (newline == string::npos) break;
+    string line = w.partialOutput.substr(start, newline - start);
+    start = newline + 1;
+    if (w.inFlight.empty()) {
+      cerr << "Worker " << w.sp.pid << " published an unexpected line: " << line << endl;
+      continue;
+    }
+    publishResult(w.inFlight.front().id, line);
+    w.inFlight.pop_front();
+  }
+  w.partialOutput.erase(0, start);
+  if (count > 0) return;
+
+  // the worker is gone (or has closed its end, which amounts to the same thing), so it's no
+  // longer available even if it hasn't been reaped yet, and its unfinished jobs go back to the
+  // front of the line
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, w.sp.ingestfd, NULL);
+  workerOutputs.erase(w.sp.ingestfd);
+  close(w.sp.ingestfd);
+  w.outputOpen = false;
+  availableWorkers.erase(remove(availableWorkers.begin(), availableWorkers.end(), index), availableWorkers.end());
+  for (auto j = w.inFlight.rbegin(); j != w.inFlight.rend(); ++j) {
+    if (j->attempts < kMaxAttempts) {
+      numJobsOutstanding--;
+      pendingJobs.push_front(*j);
+    } else {
+      publishResult(j->id, "<no result: " + to_string(j->attempts) + " workers exited while factoring " + to_string(j->number) + ">");
+    }
+  }
+  w.inFlight.clear();
+}
+
+static void publishThreadResults() {
+  uint64_t count;
+  read(resultfd, &count, sizeof(count));
+  threadResult r;
+  while (threadResults->pop(r)) {
+    resultsQueued--;
+    publishResult(r.id, r.result);
+  }
+}
+
+static bool parseNumber(const string& line, long long& num) {
+  if (line.empty()) return false;
+  char *end;
+  errno = 0;
+  num = strtoll(line.c_str(), &end, 10);
+  return errno == 0 && end != line.c_str() && *end == '\0';
+}
+
+static void queueJob(long long number) {
+  job j = {++numJobsRead, number, 0};
+  pendingJobs.push_back(j);
+}
+
+// Reads whatever stdin has to offer and queues up every complete line.  Returns false once
+// there's nothing more to read, either because stdin is exhausted or because it supplied
+// something other than a number (which, as always, ends the input).
+static string partialLine;
+static bool ingestNumbers() {
+  char buffer[1 << 16];
+  ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+  if (count == -1 && errno == EINTR) return true;
+  if (count > 0) partialLine.append(buffer, count);
+  size_t start = 0;
+  while (true) {
+    size_t newline = partialLine.find('\n', start);
+    if (newline == string::npos) break;
+    long long num;
+    if (!parseNumber(partialLine.substr(start, newline - start), num)) return false;
+    queueJob(num);
+    start = newline + 1;
+  }
+  partialLine.erase(0, start);
+  if (count > 0) return true;
+
+  long long num;
+  if (!partialLine.empty() && parseNumber(partialLine, num)) queueJob(num);
+  return false;
+}
+
+static bool withinReorderWindow() {
+  return order == kCompletionOrder || pendingJobs.front().id - nextResultToPublish < kReorderWindow;
+}
+
+static size_t nextBatchSize() {
+  size_t size = batchSize;
+  if (adaptiveBatching) {
+    size = averageJobSeconds == 0 ? 1 : size_t(kTargetBatchSeconds / averageJobSeconds);
+    size = min(size, (pendingJobs.size() + numWorkersAlive - 1) / numWorkersAlive);
+    size = min(size, kMaxBatchSize);
+  }
+  size = max<size_t>(1, min(size, pendingJobs.size()));
+  if (order == kInputOrder) size = min(size, kReorderWindow - (pendingJobs.front().id - nextResultToPublish));
+  return size;
+}
+
+// Batched workers are sent the size of the batch ahead of its numbers, and the whole
+// batch is written at once.  The worker is continued before the batch is written, so that
+// it's already reading should the batch ever outgrow what the pipe can buffer.
+static void dispatchJobs() {
+  while (!availableWorkers.empty() && !pendingJobs.empty() && withinReorderWindow()) {
+    worker& w = workers[availableWorkers.back()];
+    availableWorkers.pop_back();
+    size_t size = nextBatchSize();
+    string batch;
+    if (batchSize != 1 || adaptiveBatching) batch = to_string(size) + "\n";
+    for (size_t i = 0; i < size; i++) {
+      job& j = pendingJobs.front();
+      batch += to_string(j.number) + "\n";
+      j.attempts++;
+      w.inFlight.push_back(j);
+      pendingJobs.pop_front();
     }
+    w.batchSize = size;
+    w.dispatched = chrono::steady_clock::now();
+    kill(w.sp.pid, SIGCONT);
+    write(w.sp.supplyfd, batch.data(), batch.size());
+    numJobsOutstanding += size;
   }
+}
 
-  sigprocmask(SIG_UNBLOCK, &additions, NULL);
-  return availableWorkers;
+static void dispatchJobsToThreads() {
+  while (!pendingJobs.empty() && withinReorderWindow() && numJobsOutstanding < kThreadQueueCapacity) {
+    bool queued = false;
+    for (size_t i = 0; i < threadQueues.size() && !queued; i++) {
+      queued = threadQueues[nextThreadQueue]->push(pendingJobs.front());
+      nextThreadQueue = (nextThreadQueue + 1) % threadQueues.size();
+    }
+    if (!queued) break;
+    pendingJobs.pop_front();
+    numJobsOutstanding++;
+    sem_post(&jobsAvailable);
+  }
 }
 
+static void retireWorker(size_t index) {
+  worker& w = workers[index];
+  w.retiring = true;
+  numWorkersRetiring++;
+  close(w.sp.supplyfd);
+  kill(w.sp.pid, SIGCONT);
+  cerr << "Worker " << w.sp.pid << " has been idle for a while, so it's being retired." << endl;
+}
+
+// Grows the pool when jobs are waiting on busy workers (and no newly spawned workers are
+// still coming up), and shrinks it when the longest-idle worker has been idle for too long.
+// Returns the number of milliseconds until the pool should next be adjusted, or -1 if there's
+// no need until something happens.  With no workers alive (say, because spawning keeps failing),
+// there may be nothing left in the epoll set to wake the event loop, so 0 is returned instead and
+// the loop keeps calling back until the pool recovers or the crash limit gives up on it.
+static int adjustPoolSize() {
+  size_t numWorkersActive = numWorkersAlive - numWorkersRetiring;
+  if (numConsecutiveCrashes < kMaxConsecutiveCrashes) {
+    size_t wanted = max(minWorkers, numWorkersActive);
+    if (!pendingJobs.empty() && withinReorderWindow() && availableWorkers.empty() && numWorkersStarting == 0)
+      wanted = min(maxWorkers, max<size_t>(numWorkersActive * 2, 1));
+    bool spawned = false;
+    for (; numWorkersActive < wanted && spawnWorker(); numWorkersActive++) spawned = true;
+    if (spawned) markWorkersAsAvailable();
+  }
+
+  numWorkersActive = numWorkersAlive - numWorkersRetiring;
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  for (; numWorkersActive > minWorkers && !availableWorkers.empty(); numWorkersActive--) {
+    size_t index = availableWorkers.front();
+    if (now - workers[index].idleSince < kIdleTimeout) {
+      chrono::milliseconds remaining = chrono::duration_cast<chrono::milliseconds>(workers[index].idleSince + kIdleTimeout - now);
+      return remaining.count() + 1;
+    }
+    availableWorkers.pop_front();
+    retireWorker(index);
+  }
+  return numWorkersAlive == 0 ? 0 : -1;
+}
+
+static void handleEvents(struct epoll_event events[], int count, bool& readInput) {
+  for (int i = 0; i < count; i++) {
+    if (events[i].data.fd == sigchldfd) {
+      markWorkersAsAvailable();
+    } else if (events[i].data.fd == resultfd) {
+      publishThreadResults();
+    } else if (events[i].data.fd == STDIN_FILENO) {
+      readInput = true;
+    } else {
+      auto found = workerOutputs.find(events[i].data.fd);
+      if (found != workerOutputs.end()) publishResults(found->second);
+    }
+  }
+}
+
+// epoll refuses regular files (which are always readable anyway), in which case stdin is
+// read whenever there's room for more numbers, without waiting on it.  Results are flushed
+// whenever the loop is about to block.
 static void broadcastNumbersToWorkers() {
-  while(true) {
-    string line;
-    getline(cin, line);
-    if (cin.fail()) break;
-    size_t endpos;
-    long long num = stoll(line, &endpos);
-    if (endpos != line.size()) break;
-
-    size_t numWorkers = getAvailableWorker();
-    if(numWorkers < kNumCPUs) {
-      workers[numWorkers].available = false;
-      numWorkersAvailable--;
-      dprintf(workers[numWorkers].sp.supplyfd, "%lld\n", num);
-      kill(workers[numWorkers].sp.pid, SIGCONT);
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = STDIN_FILENO;
+  bool stdinPollable = epoll_ctl(epollfd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0;
+  bool stdinWatched = stdinPollable;
+  bool inputDone = false;
+  vector<struct epoll_event> events(2 + placement.size());
+  int timeout = -1;
+  if (!threadMode) markWorkersAsAvailable();
+  while (!(inputDone && pendingJobs.empty() && numJobsOutstanding == 0)) {
+    if (numWorkersAlive == 0 && numJobsOutstanding == 0 && numConsecutiveCrashes >= kMaxConsecutiveCrashes) {
+      cerr << "All workers have exited, so " << (inputDone ? "some numbers" : "the remaining input")
+           << " will never be factored." << endl;
+      break;
+    }
+
+    bool wantInput = !inputDone && pendingJobs.size() < kMaxPendingJobs;
+    if (stdinPollable && stdinWatched != wantInput && !inputDone) {
+      event.events = wantInput ? EPOLLIN : 0;
+      epoll_ctl(epollfd, EPOLL_CTL_MOD, STDIN_FILENO, &event);
+      stdinWatched = wantInput;
+    }
+
+    bool readInput = wantInput && !stdinPollable;
+    if (!readInput) cout.flush();
+    int count = epoll_wait(epollfd, events.data(), events.size(), readInput ? 0 : timeout);
+    handleEvents(events.data(), count, readInput);
+    if (readInput && !ingestNumbers()) {
+      inputDone = true;
+      if (stdinPollable) epoll_ctl(epollfd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+    }
+    if (threadMode) {
+      dispatchJobsToThreads();
+    } else {
+      dispatchJobs();
+      timeout = adjustPoolSize();
     }
   }
+  cout.flush();
 }
 
 static void waitForAllWorkers() {
-  sigset_t additions, existingmask;
-  sigemptyset(&additions);
-  sigaddset(&additions, SIGCHLD);
-  sigprocmask(SIG_BLOCK, &additions, &existingmask);
-  while(numWorkersAvailable != kNumCPUs) {
-    sigsuspend(&existingmask);
+  vector<struct epoll_event> events(2 + placement.size());
+  while (availableWorkers.size() < numWorkersAlive) {
+    bool readInput = false;
+    int count = epoll_wait(epollfd, events.data(), events.size(), -1);
+    handleEvents(events.data(), count, readInput);
   }
-  sigprocmask(SIG_UNBLOCK, &additions, NULL);
+  cout.flush();
 }
 
 static void closeAllWorkers() {
-  signal(SIGCHLD, SIG_DFL);
-
-  for(size_t worker = 0; worker < kNumCPUs; worker++) {
+  for (size_t worker = 0; worker < workers.size(); worker++) {
+    if (!workers[worker].alive || workers[worker].retiring) continue;
     close(workers[worker].sp.supplyfd);
     kill(workers[worker].sp.pid, SIGCONT);
   }
 
-  for(size_t i = 0; i < kNumCPUs; i++) {
-    while(true) {
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (!workers[i].alive) continue;
+    while (true) {
       int status;
-      waitpid(workers[i].sp.pid, &status, 0);
-      if(WIFEXITED(status)) break;
+      if (waitpid(workers[i].sp.pid, &status, 0) == -1) break;
+      if (WIFEXITED(status) || WIFSIGNALED(status)) break;
+    }
+  }
+}
+
+static void stopAllThreads() {
+  threadsStopping = true;
+  for (size_t i = 0; i < threads.size(); i++) sem_post(&jobsAvailable);
+  for (thread& t: threads) t.join();
+  sem_destroy(&jobsAvailable);
+}
+
+static bool parseBatchSize(const string& value) {
+  if (value == "auto") {
+    adaptiveBatching = true;
+    return true;
+  }
+  long long size;
+  if (!parseNumber(value, size) || size < 1 || size > (long long) kMaxBatchSize) return false;
+  batchSize = size;
+  return true;
+}
+
+// Accepts either a range (e.g. 2-8) or a single number, which fixes the size of the pool.
+static bool parsePoolSize(const string& value) {
+  size_t dash = value.find('-');
+  long long low, high;
+  if (!parseNumber(value.substr(0, dash), low)) return false;
+  if (dash == string::npos) high = low;
+  else if (!parseNumber(value.substr(dash + 1), high)) return false;
+  if (low < 1 || high < low) return false;
+  minWorkers = low;
+  maxWorkers = high;
+  return true;
+}
+
+static const string kOrderFlag = "--order=";
+static const string kBatchFlag = "--batch=";
+static const string kWorkerFlag = "--worker=";
+static const string kThreadsFlag = "--threads";
+static const string kPlacementFlag = "--placement=";
+static const string kWorkersFlag = "--workers=";
+static bool processCommandLineFlags(char *argv[]) {
+  for (size_t i = 1; argv[i] != NULL; i++) {
+    string flag = argv[i];
+    if (flag == kOrderFlag + "input") order = kInputOrder;
+    else if (flag == kOrderFlag + "completion") order = kCompletionOrder;
+    else if (flag.compare(0, kBatchFlag.size(), kBatchFlag) == 0 && parseBatchSize(flag.substr(kBatchFlag.size()))) continue;
+    else if (flag.compare(0, kWorkerFlag.size(), kWorkerFlag) == 0 && flag.size() > kWorkerFlag.size()) workerExecutable = flag.substr(kWorkerFlag.size());
+    else if (flag == kThreadsFlag) threadMode = true;
+    else if (flag == kPlacementFlag + "smt") policy = kFillSMT;
+    else if (flag == kPlacementFlag + "core") policy = kOnePerCore;
+    else if (flag == kPlacementFlag + "spread") policy = kSpreadNodes;
+    else if (flag.compare(0, kWorkersFlag.size(), kWorkersFlag) == 0 && parsePoolSize(flag.substr(kWorkersFlag.size()))) continue;
+    else {
+      cerr << argv[0] << ": Unrecognized flag (" << flag << ")" << endl;
+      cerr << "Usage: " << argv[0] << " [--order=input|completion] [--batch=<1-" << kMaxBatchSize << ">|auto] [--worker=<executable>|--threads] [--placement=smt|core|spread] [--workers=<min>[-<max>]]" << endl;
+      return false;
     }
   }
+  return true;
 }
 
 int main(int argc, char *argv[]) {
-  signal(SIGCHLD, markWorkersAsAvailable);
+  if (!processCommandLineFlags(argv)) return 1;
+  planWorkerPlacement();
+  if (threadMode) {
+    if (!loadPrimeTable()) {
+      cerr << argv[0] << ": Failed to build the table of primes." << endl;
+      return 1;
+    }
+    spawnAllThreads();
+    watchThreads();
+    broadcastNumbersToWorkers();
+    stopAllThreads();
+    return 0;
+  }
+
+  signal(SIGPIPE, SIG_IGN); // a worker can die after it stops and before it's sent its next batch
   spawnAllWorkers();
+  watchWorkers();
   broadcastNumbersToWorkers();
   waitForAllWorkers();
   closeAllWorkers();
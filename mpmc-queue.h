@@ -0,0 +1,98 @@
+/**
+ * File: mpmc-queue.h
+ * ------------------
+ * Exports MPMCQueue, a bounded, lock-free queue that any number of threads may push onto and
+ * pop from at once.  It's the ring buffer Dmitry Vyukov popularized: each cell carries a sequence
+ * number that says whether it's ready to be written (sequence == position) or read (sequence ==
+ * position + 1), so producers and consumers each claim a cell with a single compare-and-swap on
+ * their own counter, and never touch the other side's.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+template <typename T>
+class MPMCQueue {
+ public:
+  /**
+   * Constructor: MPMCQueue
+   * ----------------------
+   * Constructs an empty queue with room for capacity elements, where capacity
+   * must be a power of two.
+   */
+  explicit MPMCQueue(size_t capacity) : cells(new cell[capacity]), mask(capacity - 1), enqueuePosition(0), dequeuePosition(0) {
+    for (size_t i = 0; i < capacity; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  /**
+   * Method: push
+   * ------------
+   * Copies the supplied element onto the back of the queue, returning false
+   * (and leaving the queue untouched) if it's full.
+   */
+  bool push(const T& element) {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      cell& c = cells[position & mask];
+      size_t sequence = c.sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          c.element = element;
+          c.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (sequence < position) {
+        return false;
+      } else {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Method: pop
+   * -----------
+   * Moves the element at the front of the queue into the supplied reference,
+   * returning false (and leaving the reference untouched) if the queue is empty.
+   */
+  bool pop(T& element) {
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      cell& c = cells[position & mask];
+      size_t sequence = c.sequence.load(std::memory_order_acquire);
+      if (sequence == position + 1) {
+        if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          element = std::move(c.element);
+          c.sequence.store(position + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (sequence < position + 1) {
+        return false;
+      } else {
+        position = dequeuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  struct cell {
+    std::atomic<size_t> sequence;
+    T element;
+  };
+
+  // the two positions are kept on separate cache lines from each other and from
+  // the cells, so producers and consumers don't slow each other down
+  static const size_t kCacheLineSize = 64;
+  std::unique_ptr<cell[]> cells;
+  const size_t mask;
+  char padding1[kCacheLineSize];
+  std::atomic<size_t> enqueuePosition;
+  char padding2[kCacheLineSize];
+  std::atomic<size_t> dequeuePosition;
+  char padding3[kCacheLineSize];
+
+  MPMCQueue(const MPMCQueue&) = delete;
+  MPMCQueue& operator=(const MPMCQueue&) = delete;
+};
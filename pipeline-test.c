@@ -47,7 +47,42 @@ static void simpleTest() {
   launchPipedExecutables(argv1, argv2);
 }
 
+static void launchPipedStages(char **argvs[], size_t n, int pipeCapacity) {
+  printf("Pipeline: ");
+  for (size_t i = 0; i < n; i++) {
+    if (i > 0) printf(" -> ");
+    printArgumentVector(argvs[i]);
+  }
+  printf("\n");
+  fflush(stdout); // otherwise the stages' output can overtake the summary
+  pid_t pids[n];
+  if (pipelineN(argvs, n, pids, pipeCapacity) == -1) printf("Not every stage could be launched.\n");
+  int status = waitForPipeline(pids, n, NULL);
+  printf("Pipeline exited with status %d.\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+}
+
+static void multistageTest() {
+  char *argv1[] = {"cat", "/usr/include/tar.h", NULL};
+  char *argv2[] = {"tr", "-cs", "A-Za-z", "\\n", NULL};
+  char *argv3[] = {"sort", NULL};
+  char *argv4[] = {"uniq", NULL};
+  char *argv5[] = {"wc", "-l", NULL};
+  char **argvs[] = {argv1, argv2, argv3, argv4, argv5};
+  launchPipedStages(argvs, 5, 0);
+  launchPipedStages(argvs, 5, 1 << 20);
+}
+
+static void missingStageTest() {
+  char *argv1[] = {"cat", "/usr/include/tar.h", NULL};
+  char *argv2[] = {"no-such-executable", NULL};
+  char *argv3[] = {"wc", NULL};
+  char **argvs[] = {argv1, argv2, argv3};
+  launchPipedStages(argvs, 3, 0);
+}
+
 int main(int argc, char *argv[]) {
   simpleTest();
+  multistageTest();
+  missingStageTest();
   return 0;
 }
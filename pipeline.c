@@ -1,40 +1,76 @@
 /**
  * File: pipeline.c
  * ----------------
- * Presents the implementation of the pipeline routine.
+ * Presents the implementation of the pipeline routines.
  */
 
+#define _GNU_SOURCE // for pipe2 and F_SETPIPE_SZ
 #include "pipeline.h"
 #include <stdio.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
 #include "fork-utils.h"  // this has to be the last #include'd statement in the file
 
 void pipeline(char *argv1[], char *argv2[], pid_t pids[]) {
-  pid_t pid1, pid2;
-  int fds[2];
+  char **argvs[] = {argv1, argv2};
+  pipelineN(argvs, 2, pids, 0);
+}
+
+static void closeAll(int fds[], size_t count) {
+  for (size_t i = 0; i < count; i++) close(fds[i]);
+}
 
-  pipe(fds);
+/**
+ * Every pipe is created close-on-exec, so each stage inherits only the two ends
+ * dup2'ed onto its stdin and stdout (dup2 clears the flag on the copies), and no
+ * stage can keep another stage's input open by accident.  Stages are launched with
+ * posix_spawnp, so the cost of each doesn't grow with the size of the parent.
+ */
+int pipelineN(char **argvs[], size_t n, pid_t pids[], int pipeCapacity) {
+  if (n == 0) return 0;
+  int fds[2 * n]; // fds[2 * i] and fds[2 * i + 1] connect stage i to stage i + 1
+  for (size_t i = 0; i + 1 < n; i++) {
+    if (pipe2(fds + 2 * i, O_CLOEXEC) == -1) {
+      int err = errno;
+      closeAll(fds, 2 * i);
+      for (size_t j = 0; j < n; j++) pids[j] = -1;
+      errno = err;
+      return -1;
+    }
+    if (pipeCapacity > 0) fcntl(fds[2 * i + 1], F_SETPIPE_SZ, pipeCapacity); // best effort
+  }
 
-  pid1 = fork();
-  if (pid1 == 0) {
-    close(fds[0]);
-    dup2(fds[1], STDOUT_FILENO);
-    close(fds[1]);
-    execvp(argv1[0], argv1);
-  } else {
-    pids[0] = pid1;
+  bool launched = true;
+  for (size_t i = 0; i < n; i++) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (i > 0) posix_spawn_file_actions_adddup2(&actions, fds[2 * (i - 1)], STDIN_FILENO);
+    if (i + 1 < n) posix_spawn_file_actions_adddup2(&actions, fds[2 * i + 1], STDOUT_FILENO);
+    int err = posix_spawnp(&pids[i], argvs[i][0], &actions, NULL, argvs[i], environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0) {
+      pids[i] = -1;
+      errno = err;
+      launched = false;
+    }
   }
 
-  pid2 = fork();
-  if (pid2 == 0) {
-    close(fds[1]);
-    dup2(fds[0], STDIN_FILENO);
-    close(fds[0]);
-    execvp(argv2[0], argv2);
-  } else {
-    pids[1] = pid2;
+  closeAll(fds, 2 * (n - 1));
+  return launched ? 0 : -1;
+}
+
+int waitForPipeline(const pid_t pids[], size_t n, int statuses[]) {
+  int last = -1;
+  for (size_t i = 0; i < n; i++) {
+    int status = -1;
+    if (pids[i] != -1) {
+      while (waitpid(pids[i], &status, 0) == -1 && errno == EINTR);
+    }
+    if (statuses != NULL) statuses[i] = status;
+    last = status;
   }
-  close(fds[0]);
-  close(fds[1]);
+  return last;
 }
@@ -4,8 +4,10 @@
  * Exports the pipeline routine, which launches
  * two sister executables such that the standout
  * output of the first is routed to the standard
- * input of the second.  Check out the following
- * test framework to see how pipeline should work:
+ * input of the second, and pipelineN, which does
+ * the same for any number of executables.  Check out
+ * the following test framework to see how pipeline
+ * should work:
 
      int main(int argc, char *argv[]) {
        char *argv1[] = {"cat", "pipeline-test.c", NULL};
@@ -38,4 +40,36 @@
 
 void pipeline(char *argv1[], char *argv2[], pid_t pids[]);
 
+/**
+ * Function: pipelineN
+ * -------------------
+ * Generalizes pipeline to any number of stages: spawns n sister processes, the ith
+ * around the argument vector supplied via argvs[i], places the process id of the ith
+ * in pids[i], and pipes the standard output of each to the standard input of the next.
+ * The first stage inherits the caller's standard input, and the last its standard output.
+ *
+ * If pipeCapacity is positive, each pipe's capacity is set to that many bytes (as with
+ * fcntl's F_SETPIPE_SZ) so that high-throughput stages can run further ahead of their
+ * consumers.  The kernel rounds the capacity up to a power-of-two number of pages and caps
+ * it at /proc/sys/fs/pipe-max-size (for unprivileged callers); a capacity that can't be
+ * set is silently left at the default.
+ *
+ * Returns 0 if every stage was launched.  Otherwise returns -1 with errno set: pids[i] is -1
+ * for each stage that couldn't be launched, but any others are running and still need to be
+ * waited on, which waitForPipeline takes care of.
+ */
+
+int pipelineN(char **argvs[], size_t n, pid_t pids[], int pipeCapacity);
+
+/**
+ * Function: waitForPipeline
+ * -------------------------
+ * Waits for every stage of a pipeline launched by pipelineN (or pipeline) to finish,
+ * skipping any whose pid is -1.  If statuses isn't NULL, statuses[i] is set to the ith
+ * stage's status as reported by waitpid (or -1 if it never ran).  Returns the status of
+ * the last stage, which, as with shells, is the status of the pipeline as a whole.
+ */
+
+int waitForPipeline(const pid_t pids[], size_t n, int statuses[]);
+
 #endif
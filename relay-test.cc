@@ -0,0 +1,173 @@
+/**
+ * File: relay-test.cc
+ * -------------------
+ * Exercises the relay routines: relays a child's output into a file, fans a child's output (and
+ * then a file) out to files and other children, publishes a buffer with vmsplice, and finally
+ * compares relay's bandwidth out of a pipe against copying through user space.  Exits with
+ * status 0 if and only if every destination received exactly what it should have.
+ */
+
+#include "relay.h"
+#include "subprocess.h"
+#include "test-utils.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace std;
+
+static const size_t kNumLines = 200000;
+static const char *const kProducer[] = {"seq", "1", "200000", NULL};
+static const char *const kCounter[] = {"wc", "-c", NULL};
+static const size_t kBulkBytes = 1 << 30;
+static const size_t kBulkChunkSize = 1 << 20;
+
+static string expectedOutput() {
+  string expected;
+  for (size_t i = 1; i <= kNumLines; i++) expected += to_string(i) + "\n";
+  return expected;
+}
+
+static string readEverything(int fd) {
+  string contents;
+  char buffer[1 << 16];
+  ssize_t count;
+  while ((count = read(fd, buffer, sizeof(buffer))) > 0) contents.append(buffer, count);
+  return contents;
+}
+
+static int createTemporaryFile(string& name) {
+  char pattern[] = "/tmp/relay-test-XXXXXX";
+  int fd = mkstemp(pattern);
+  name = pattern;
+  return fd;
+}
+
+static string contentsOf(const string& name) {
+  int fd = open(name.c_str(), O_RDONLY);
+  string contents = readEverything(fd);
+  close(fd);
+  return contents;
+}
+
+/**
+ * Function: countBytes
+ * --------------------
+ * Closes the counter's input, and returns the byte count it publishes.
+ */
+static size_t countBytes(subprocess_t& counter) {
+  close(counter.supplyfd);
+  string output = readEverything(counter.ingestfd);
+  close(counter.ingestfd);
+  waitpid(counter.pid, NULL, 0);
+  return strtoul(output.c_str(), NULL, 10);
+}
+
+static bool testRelay(const string& expected) {
+  subprocess_t producer = subprocess(const_cast<char **>(kProducer), false, true);
+  string name;
+  int fd = createTemporaryFile(name);
+  size_t count = relay(producer.ingestfd, fd);
+  close(fd);
+  close(producer.ingestfd);
+  waitpid(producer.pid, NULL, 0);
+  bool passed = check("relay from a child to a file", count == expected.size() && contentsOf(name) == expected);
+  unlink(name.c_str());
+  return passed;
+}
+
+static bool testFanOut(const string& expected) {
+  subprocess_t producer = subprocess(const_cast<char **>(kProducer), false, true);
+  subprocess_t counter = subprocess(const_cast<char **>(kCounter), true, true);
+  string first, second;
+  int fd1 = createTemporaryFile(first), fd2 = createTemporaryFile(second);
+  size_t count = relayToAll(producer.ingestfd, {fd1, counter.supplyfd, fd2});
+  close(fd1);
+  close(fd2);
+  close(producer.ingestfd);
+  waitpid(producer.pid, NULL, 0);
+  bool passed = check("fan out from a child to two files and a child",
+                      count == expected.size() && contentsOf(first) == expected &&
+                      contentsOf(second) == expected && countBytes(counter) == expected.size());
+
+  // now fan the first file back out, which needs an intermediate pipe, since it isn't one
+  subprocess_t recounter = subprocess(const_cast<char **>(kCounter), true, true);
+  string third;
+  int fd3 = createTemporaryFile(third);
+  int source = open(first.c_str(), O_RDONLY);
+  count = relayToAll(source, {recounter.supplyfd, fd3});
+  close(source);
+  close(fd3);
+  passed = check("fan out from a file to a child and a file",
+                 count == expected.size() && contentsOf(third) == expected && countBytes(recounter) == expected.size()) && passed;
+  for (const string& name: {first, second, third}) unlink(name.c_str());
+  return passed;
+}
+
+static bool testRelayBuffer(const string& expected) {
+  subprocess_t counter = subprocess(const_cast<char **>(kCounter), true, true);
+  relayBuffer(expected.data(), expected.size(), counter.supplyfd);
+  return check("publish a buffer to a child with vmsplice", countBytes(counter) == expected.size());
+}
+
+/**
+ * Function: measureBandwidth
+ * --------------------------
+ * Moves a gigabyte out of a pipe and into /dev/null, either with relay or through a user-space
+ * buffer, and returns the rate in MB/s.  The pipe is filled by a thread that vmsplices the same
+ * zeroed chunk over and over, so that it's the hop out of the pipe that's being measured, and
+ * not whatever fills it.
+ */
+static double measureBandwidth(bool useRelay) {
+  int fds[2];
+  pipe2(fds, O_CLOEXEC);
+  fcntl(fds[1], F_SETPIPE_SZ, int(kBulkChunkSize));
+  vector<char> chunk(kBulkChunkSize);
+  thread producer([&]() {
+    for (size_t sent = 0; sent < kBulkBytes; sent += chunk.size()) relayBuffer(chunk.data(), chunk.size(), fds[1]);
+    close(fds[1]);
+  });
+
+  int sink = open("/dev/null", O_WRONLY);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  size_t total = 0;
+  if (useRelay) {
+    total = relay(fds[0], sink);
+  } else {
+    vector<char> buffer(kBulkChunkSize);
+    ssize_t count;
+    while ((count = read(fds[0], buffer.data(), buffer.size())) > 0) total += write(sink, buffer.data(), count);
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  producer.join();
+  close(sink);
+  close(fds[0]);
+  return total / seconds / (1 << 20);
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    string expected = expectedOutput();
+    cout << "Testing the relay routines." << endl;
+    bool passed = testRelay(expected);
+    passed = testFanOut(expected) && passed;
+    passed = testRelayBuffer(expected) && passed;
+
+    cout << "Moving 1GB from a pipe to /dev/null:" << endl;
+    double copied = measureBandwidth(false);
+    double relayed = measureBandwidth(true);
+    cout << fixed << setprecision(0);
+    cout << "  read/write: " << copied << " MB/s" << endl;
+    cout << "  relay: " << relayed << " MB/s" << endl;
+    return passed ? 0 : 1;
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while relaying: " << se.what() << endl;
+    return 1;
+  }
+}
@@ -0,0 +1,278 @@
+/**
+ * File: relay.cc
+ * --------------
+ * Presents the implementation of the relay routines exported by relay.h.
+ */
+
+#include "relay.h"
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+using namespace std;
+
+static const size_t kDefaultChunkSize = 1 << 16; // the default capacity of a pipe
+
+static void throwRelayError(const string& operation) {
+  throw SubprocessException("relay failed to " + operation + " (" + strerror(errno) + ")");
+}
+
+static bool isPipe(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+/**
+ * Function: awaitDescriptor
+ * -------------------------
+ * Called when an operation on a nonblocking descriptor would block, and waits until
+ * the descriptor is ready for it.
+ */
+static void awaitDescriptor(int fd, short events) {
+  struct pollfd pfd = {fd, events, 0};
+  while (poll(&pfd, 1, -1) == -1 && errno == EINTR);
+}
+
+/**
+ * Function: makePipe
+ * ------------------
+ * Creates an intermediate (close-on-exec) pipe, growing it to at least the
+ * supplied capacity if need be, and returns its actual capacity.
+ */
+static size_t makePipe(int fds[], size_t capacity) {
+  if (pipe2(fds, O_CLOEXEC) == -1) throwRelayError("create a pipe");
+  int actual = fcntl(fds[1], F_GETPIPE_SZ);
+  if (actual >= 0 && size_t(actual) < capacity) actual = fcntl(fds[1], F_SETPIPE_SZ, int(capacity));
+  return actual > 0 ? actual : kDefaultChunkSize;
+}
+
+static size_t chunkSize(int fd) {
+  int capacity = isPipe(fd) ? fcntl(fd, F_GETPIPE_SZ) : -1;
+  return capacity > 0 ? capacity : kDefaultChunkSize;
+}
+
+/**
+ * Function: spliceOnce
+ * --------------------
+ * Splices up to length bytes from one descriptor to the other (at least one of which must be a pipe),
+ * waiting out EAGAIN and EINTR.  Returns the number of bytes moved (0 at end of file), or -1 if the
+ * kernel can't splice between the two descriptors.
+ */
+static ssize_t spliceOnce(int from, int to, size_t length) {
+  while (true) {
+    ssize_t count = splice(from, NULL, to, NULL, length, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (count >= 0) return count;
+    if (errno == EINTR) continue;
+    if (errno == EINVAL) return -1;
+    if (errno != EAGAIN) throwRelayError("splice");
+    awaitDescriptor(from, POLLIN);
+    awaitDescriptor(to, POLLOUT);
+  }
+}
+
+static void writeAll(int to, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t count = write(to, data, length);
+    if (count == -1 && errno == EINTR) continue;
+    if (count == -1 && errno == EAGAIN) {
+      awaitDescriptor(to, POLLOUT);
+      continue;
+    }
+    if (count == -1) throwRelayError("write");
+    data += count;
+    length -= count;
+  }
+}
+
+/**
+ * Function: readSome
+ * ------------------
+ * Reads up to length bytes into the supplied buffer, waiting out EAGAIN and EINTR, and returns
+ * the number read (0 at end of file).
+ */
+static size_t readSome(int from, char *buffer, size_t length) {
+  while (true) {
+    ssize_t count = read(from, buffer, length);
+    if (count >= 0) return count;
+    if (errno == EINTR) continue;
+    if (errno != EAGAIN) throwRelayError("read");
+    awaitDescriptor(from, POLLIN);
+  }
+}
+
+/**
+ * Function: copyRemainder
+ * -----------------------
+ * The fallback for descriptors that can't be spliced: copies through user space until end of file.
+ */
+static size_t copyRemainder(int from, int to) {
+  char buffer[kDefaultChunkSize];
+  size_t total = 0;
+  while (size_t count = readSome(from, buffer, sizeof(buffer))) {
+    writeAll(to, buffer, count);
+    total += count;
+  }
+  return total;
+}
+
+/**
+ * Function: drain
+ * ---------------
+ * Splices exactly length bytes out of the pipe from, which must already hold them, into to.
+ * If the kernel won't splice into to, the bytes are read out of the pipe and written instead.
+ */
+static void drain(int from, int to, size_t length) {
+  while (length > 0) {
+    ssize_t count = spliceOnce(from, to, length);
+    if (count == -1) {
+      char buffer[kDefaultChunkSize];
+      count = readSome(from, buffer, min(length, sizeof(buffer)));
+      writeAll(to, buffer, count);
+    }
+    length -= count;
+  }
+}
+
+size_t relay(int from, int to) throw (SubprocessException) {
+  size_t chunk = max(chunkSize(from), chunkSize(to));
+  size_t total = 0;
+  if (isPipe(from) || isPipe(to)) {
+    while (true) {
+      ssize_t count = spliceOnce(from, to, chunk);
+      if (count == 0) return total;
+      if (count == -1) return total + copyRemainder(from, to);
+      total += count;
+    }
+  }
+
+  int fds[2];
+  chunk = makePipe(fds, chunk);
+  try {
+    while (true) {
+      ssize_t count = spliceOnce(from, fds[1], chunk);
+      if (count == 0) break;
+      if (count == -1) {
+        total += copyRemainder(from, to);
+        break;
+      }
+      drain(fds[0], to, count);
+      total += count;
+    }
+  } catch (...) {
+    close(fds[0]);
+    close(fds[1]);
+    throw;
+  }
+  close(fds[0]);
+  close(fds[1]);
+  return total;
+}
+
+/**
+ * Function: fanOutChunk
+ * ---------------------
+ * Duplicates the first length bytes of the pipe source into each of the (empty) pipes in staging,
+ * starting with staging pipe first (those before it have already been filled), and then consumes
+ * them from source on behalf of the last destination and drains each staging pipe into its own.
+ * Each staging pipe is at least as large as source, so tee should always duplicate everything asked
+ * of it, but should it ever fall short, the chunk is read out of source and written the slow way.
+ */
+static void fanOutChunk(int source, const vector<int>& to, const vector<int>& staging, size_t first, size_t length) {
+  size_t last = to.size() - 1;
+  for (size_t i = first; i < last; i++) {
+    ssize_t count;
+    while ((count = tee(source, staging[2 * i + 1], length, 0)) == -1 && errno == EINTR);
+    if (count == -1) throwRelayError("tee");
+    if (size_t(count) == length) continue;
+
+    vector<char> buffer(length);
+    for (size_t filled = 0; filled < length; ) filled += readSome(source, buffer.data() + filled, length - filled);
+    drain(staging[2 * i], to[i], count);
+    writeAll(to[i], buffer.data() + count, length - count);
+    for (size_t j = 0; j < i; j++) drain(staging[2 * j], to[j], length);
+    for (size_t j = i + 1; j <= last; j++) writeAll(to[j], buffer.data(), length);
+    return;
+  }
+
+  drain(source, to[last], length);
+  for (size_t i = 0; i < last; i++) drain(staging[2 * i], to[i], length);
+}
+
+size_t relayToAll(int from, const vector<int>& to) throw (SubprocessException) {
+  if (to.empty()) throw SubprocessException("relay needs at least one destination");
+  if (to.size() == 1) return relay(from, to[0]);
+
+  // every destination but the last gets its own staging pipe, and if from isn't
+  // a pipe, its bytes are first spliced into one so that they can be tee'd
+  vector<int> staging;
+  int source[2] = {from, -1};
+  size_t chunk = chunkSize(from);
+  size_t total = 0;
+  try {
+    if (!isPipe(from)) chunk = makePipe(source, chunk);
+    for (size_t i = 0; i + 1 < to.size(); i++) {
+      int fds[2];
+      makePipe(fds, chunk);
+      staging.push_back(fds[0]);
+      staging.push_back(fds[1]);
+    }
+
+    while (true) {
+      // the first tee both reveals how much there is to fan out and fills the first staging pipe
+      ssize_t count;
+      if (source[0] == from) {
+        while ((count = tee(from, staging[1], chunk, 0)) == -1 && errno == EINTR);
+        if (count == -1 && errno == EAGAIN) {
+          awaitDescriptor(from, POLLIN);
+          continue;
+        }
+        if (count == -1) throwRelayError("tee");
+      } else {
+        count = spliceOnce(from, source[1], chunk);
+        if (count == -1) throwRelayError("splice from the source descriptor");
+      }
+      if (count == 0) break;
+      fanOutChunk(source[0], to, staging, source[0] == from ? 1 : 0, count);
+      total += count;
+    }
+  } catch (...) {
+    for (int fd: staging) close(fd);
+    if (source[1] != -1) {
+      close(source[0]);
+      close(source[1]);
+    }
+    throw;
+  }
+
+  for (int fd: staging) close(fd);
+  if (source[1] != -1) {
+    close(source[0]);
+    close(source[1]);
+  }
+  return total;
+}
+
+void relayBuffer(const void *data, size_t length, int to) throw (SubprocessException) {
+  const char *bytes = static_cast<const char *>(data);
+  if (!isPipe(to)) {
+    writeAll(to, bytes, length);
+    return;
+  }
+
+  while (length > 0) {
+    struct iovec iov = {const_cast<char *>(bytes), length};
+    ssize_t count = vmsplice(to, &iov, 1, 0);
+    if (count == -1 && errno == EINTR) continue;
+    if (count == -1 && errno == EAGAIN) {
+      awaitDescriptor(to, POLLOUT);
+      continue;
+    }
+    if (count == -1) throwRelayError("vmsplice");
+    bytes += count;
+    length -= count;
+  }
+}
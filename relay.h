@@ -0,0 +1,58 @@
+/**
+ * File: relay.h
+ * -------------
+ * Exports routines that move bytes between descriptors (a subprocess's supplyfd and ingestfd,
+ * the pipes connecting pipeline stages, files, and sockets) without copying them through user
+ * space.  They're built on splice(2), which moves pages between a pipe and any other descriptor,
+ * tee(2), which duplicates the contents of one pipe into another without consuming them, and
+ * vmsplice(2), which maps user memory into a pipe.
+ *
+ * Sample program, which forwards everything a child publishes to a file and to two more children:
+
+  subprocess_t producer = subprocess(producerArgv, false, true);
+  subprocess_t sorter = subprocess(sortArgv, true, false);
+  subprocess_t counter = subprocess(wcArgv, true, false);
+  int log = open("producer.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  relayToAll(producer.ingestfd, {log, sorter.supplyfd, counter.supplyfd});
+  close(sorter.supplyfd);
+  close(counter.supplyfd);
+
+ * Errors are reported by throwing a SubprocessException, as subprocess does.
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "subprocess-exception.h"
+
+/**
+ * Function: relay
+ * ---------------
+ * Moves everything from one descriptor to another until the first reaches end of file, and
+ * returns the number of bytes moved.  If neither descriptor is a pipe, the bytes are spliced
+ * through an intermediate pipe.  Should the kernel refuse to splice (as it does, for instance,
+ * into files opened with O_APPEND), whatever remains is copied with read and write instead.
+ * Nonblocking descriptors are waited on with poll, so either kind works.
+ */
+size_t relay(int from, int to) throw (SubprocessException);
+
+/**
+ * Function: relayToAll
+ * --------------------
+ * Fans out everything from one descriptor to each of the others, until the first reaches end
+ * of file, and returns the number of bytes read from it.  Every destination receives the same
+ * bytes, duplicated by tee (or, if from isn't a pipe, spliced into a pipe first), so that no
+ * byte is ever copied through user space.  The destinations advance together, so the slowest
+ * of them sets the pace.
+ */
+size_t relayToAll(int from, const std::vector<int>& to) throw (SubprocessException);
+
+/**
+ * Function: relayBuffer
+ * ---------------------
+ * Publishes the supplied bytes to the descriptor and returns once all of them have been
+ * accepted.  If the descriptor is a pipe, the bytes are mapped into it with vmsplice rather
+ * than copied, in which case the memory must not be changed until the reader has consumed
+ * them.  Otherwise, they're simply written.
+ */
+void relayBuffer(const void *data, size_t length, int to) throw (SubprocessException);
@@ -7,8 +7,9 @@
  * 
  *    > ./trace ./simple-test4
  *
- * This particular example is used to demonstrate that trace follows execution of the
- * parent and not the child in a fork() scenario.  The sleep(1) call in the child
+ * This particular example is used to demonstrate that trace follows execution of both the
+ * parent and the child in a fork() scenario, prefixing each line with the id of the process
+ * that made the system call while both are alive.  The sleep(1) call in the child
  * is in place to make it virtually impossible for a SIGCHLD signal to be sent to the
  * parent before it exits.
  */
@@ -0,0 +1,74 @@
+/**
+ * File: subprocess-benchmark.cc
+ * -----------------------------
+ * Measures how many children per second subprocess can spawn (and reap) with each spawnStrategy,
+ * as the parent's address space grows.  Each child runs /bin/true with its stdin and stdout both
+ * piped back to the parent, the way farm spawns its workers.  The parent is grown by touching
+ * every page of a large allocation, since only mapped pages cost fork anything to copy.
+ *
+ * Usage: subprocess-benchmark [<spawns per measurement>]
+ */
+
+#include "subprocess.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/wait.h>
+using namespace std;
+
+static const char *const kChildCommand[] = {"/bin/true", NULL};
+static const size_t kParentSizesInMB[] = {0, 64, 256, 1024};
+static const size_t kDefaultNumSpawns = 500;
+
+/**
+ * Function: spawnsPerSecond
+ * -------------------------
+ * Spawns and reaps numSpawns children one after another using the specified strategy, and
+ * returns the rate at which it did so.
+ */
+static double spawnsPerSecond(spawnStrategy strategy, size_t numSpawns) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < numSpawns; i++) {
+    subprocess_t sp = subprocess(const_cast<char **>(kChildCommand), true, true, strategy);
+    close(sp.supplyfd);
+    close(sp.ingestfd);
+    waitpid(sp.pid, NULL, 0);
+  }
+  return numSpawns / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t numSpawns = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultNumSpawns;
+  if (numSpawns == 0) numSpawns = kDefaultNumSpawns;
+  cout << "Spawning " << numSpawns << " children per measurement." << endl;
+  cout << setw(12) << "parent (MB)" << setw(16) << "fork/exec/s" << setw(16) << "posix_spawn/s" << setw(10) << "speedup" << endl;
+
+  vector<char *> ballast;
+  size_t currentMB = 0;
+  try {
+    for (size_t parentMB: kParentSizesInMB) {
+      if (parentMB > currentMB) {
+        size_t bytes = (parentMB - currentMB) << 20;
+        char *block = static_cast<char *>(malloc(bytes));
+        if (block == NULL) break;
+        memset(block, 1, bytes);
+        ballast.push_back(block);
+        currentMB = parentMB;
+      }
+
+      double forked = spawnsPerSecond(kForkExec, numSpawns);
+      double spawned = spawnsPerSecond(kPosixSpawn, numSpawns);
+      cout << fixed << setprecision(0) << setw(12) << currentMB << setw(16) << forked << setw(16) << spawned
+           << setprecision(1) << setw(9) << spawned / forked << "x" << endl;
+    }
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while spawning \"" << kChildCommand[0] << "\": " << se.what() << endl;
+    return 1;
+  }
+
+  for (char *block: ballast) free(block);
+  return 0;
+}
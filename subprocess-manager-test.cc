@@ -0,0 +1,180 @@
+/**
+ * File: subprocess-manager-test.cc
+ * --------------------------------
+ * Exercises the SubprocessManager: drives a couple of thousand children at once from this one
+ * thread, some through futures and some through handlers, some fed all of their input up front
+ * and some fed a line at a time as they can accept it, some that exit without reading their
+ * input at all, and some that close their input but keep running.  Each test reports whether
+ * every one of its children published and exited as it should, and the exit status is nonzero
+ * if any test failed.
+ */
+
+#include "subprocess-manager.h"
+#include "test-utils.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+using namespace std;
+
+static const size_t kNumChildren = 2000;
+static const size_t kNumLines = 100;
+static const char *const kCat[] = {"cat", NULL};
+static const char *const kQuitter[] = {"sh", "-c", "exit 3", NULL};
+static const char *const kStdinCloser[] = {"sh", "-c", "exec 0<&-; sleep 1", NULL};
+static const size_t kMaxPollsForStdinClosers = 1000;
+
+/**
+ * Function: raiseDescriptorLimit
+ * ------------------------------
+ * Each child ties up three descriptors, so the soft limit on open descriptors (usually 1024)
+ * is raised as far as the hard limit allows.
+ */
+static void raiseDescriptorLimit() {
+  struct rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+static string linesFor(size_t child) {
+  string lines;
+  for (size_t i = 0; i < kNumLines; i++) lines += to_string(child) + ":" + to_string(i) + "\n";
+  return lines;
+}
+
+/**
+ * Function: testFutures
+ * ---------------------
+ * Spawns cats that are supplied all of their input at once, and collects their output and
+ * status through futures.
+ */
+static bool testFutures(size_t numChildren) {
+  SubprocessManager manager;
+  vector<future<string>> outputs;
+  vector<future<int>> statuses;
+  for (size_t i = 0; i < numChildren; i++) {
+    pid_t pid = manager.spawn(const_cast<char **>(kCat), true, true);
+    outputs.push_back(manager.output(pid));
+    statuses.push_back(manager.exitStatus(pid));
+    manager.supply(pid, linesFor(i));
+    manager.closeInput(pid);
+  }
+  manager.run();
+
+  bool passed = manager.size() == 0;
+  for (size_t i = 0; i < numChildren; i++) {
+    passed = outputs[i].get() == linesFor(i) && passed;
+    int status = statuses[i].get();
+    passed = WIFEXITED(status) && WEXITSTATUS(status) == 0 && passed;
+  }
+  return check("collect " + to_string(numChildren) + " cats through futures", passed);
+}
+
+/**
+ * Function: testHandlers
+ * ----------------------
+ * Spawns cats that are fed a line at a time from their writable handlers, and accumulates their
+ * output and status through handlers.
+ */
+static bool testHandlers(size_t numChildren) {
+  SubprocessManager manager;
+  vector<string> outputs(numChildren);
+  vector<size_t> linesSupplied(numChildren);
+  vector<bool> ended(numChildren);
+  vector<int> statuses(numChildren, -1);
+  for (size_t i = 0; i < numChildren; i++) {
+    pid_t pid = manager.spawn(const_cast<char **>(kCat), true, true);
+    manager.onWritable(pid, [&, i, pid]() {
+      if (linesSupplied[i] == kNumLines) {
+        manager.closeInput(pid);
+        return;
+      }
+      manager.supply(pid, to_string(i) + ":" + to_string(linesSupplied[i]++) + "\n");
+    });
+    manager.onOutput(pid, [&, i](const char *data, size_t length) {
+      if (length == 0) ended[i] = true;
+      outputs[i].append(data, length);
+    });
+    manager.onExit(pid, [&, i](int status) { statuses[i] = status; });
+  }
+  manager.run();
+
+  bool passed = manager.size() == 0;
+  for (size_t i = 0; i < numChildren; i++)
+    passed = ended[i] && outputs[i] == linesFor(i) && WIFEXITED(statuses[i]) && WEXITSTATUS(statuses[i]) == 0 && passed;
+  return check("feed and drain " + to_string(numChildren) + " cats through handlers", passed);
+}
+
+/**
+ * Function: testQuitters
+ * ----------------------
+ * Spawns children that exit without reading any of the (large) input queued for them, and
+ * confirms the manager discards it rather than blocking.
+ */
+static bool testQuitters(size_t numChildren) {
+  SubprocessManager manager;
+  vector<future<int>> statuses;
+  string input(1 << 20, 'x');
+  for (size_t i = 0; i < numChildren; i++) {
+    pid_t pid = manager.spawn(const_cast<char **>(kQuitter), true, false);
+    statuses.push_back(manager.exitStatus(pid));
+    manager.supply(pid, input);
+  }
+  manager.run();
+
+  bool passed = manager.size() == 0;
+  for (future<int>& status: statuses) {
+    int value = status.get();
+    passed = WIFEXITED(value) && WEXITSTATUS(value) == 3 && passed;
+  }
+  return check("abandon input to " + to_string(numChildren) + " children that never read it", passed);
+}
+
+/**
+ * Function: testStdinClosers
+ * --------------------------
+ * Spawns children that close their stdin straight away but keep running for a second, and
+ * confirms the manager stops watching their input then, rather than being woken up over and
+ * over by the error the pipe reports until they exit.
+ */
+static bool testStdinClosers(size_t numChildren) {
+  SubprocessManager manager;
+  vector<future<int>> statuses;
+  for (size_t i = 0; i < numChildren; i++) {
+    pid_t pid = manager.spawn(const_cast<char **>(kStdinCloser), true, false);
+    statuses.push_back(manager.exitStatus(pid));
+  }
+  size_t numPolls = 0;
+  for (; manager.size() > 0; numPolls++) manager.poll(-1);
+
+  bool passed = numPolls < kMaxPollsForStdinClosers;
+  for (future<int>& status: statuses) {
+    int value = status.get();
+    passed = WIFEXITED(value) && WEXITSTATUS(value) == 0 && passed;
+  }
+  return check("wait on " + to_string(numChildren) + " children that close stdin early (" +
+               to_string(numPolls) + " polls)", passed);
+}
+
+int main(int argc, char *argv[]) {
+  signal(SIGPIPE, SIG_IGN);
+  raiseDescriptorLimit();
+  try {
+    cout << "Testing the SubprocessManager." << endl;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool passed = testFutures(kNumChildren);
+    passed = testHandlers(kNumChildren) && passed;
+    passed = testQuitters(kNumChildren / 10) && passed;
+    passed = testStdinClosers(kNumChildren / 10) && passed;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Managed " << kNumChildren * 2 + kNumChildren / 5 << " children in " << seconds << "s." << endl;
+    return passed ? 0 : 1;
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while managing subprocesses: " << se.what() << endl;
+    return 1;
+  }
+}
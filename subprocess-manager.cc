@@ -0,0 +1,276 @@
+/**
+ * File: subprocess-manager.cc
+ * ---------------------------
+ * Presents the implementation of the SubprocessManager class.
+ */
+
+#include "subprocess-manager.h"
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+using namespace std;
+
+// Everything known about one managed child.  A descriptor is kNotInUse once it's been closed
+// (or if it was never opened), and the child is forgotten once all three are.
+struct SubprocessManager::child {
+  child() : pid(-1), pidfd(kNotInUse), supplyfd(kNotInUse), ingestfd(kNotInUse), inputClosing(false), collectingOutput(false) {}
+  pid_t pid;
+  int pidfd;
+  int supplyfd;
+  int ingestfd;
+  uint64_t serial;
+  string pendingInput;
+  bool inputClosing;
+  bool collectingOutput;
+  string collectedOutput;
+  exitHandler exited;
+  outputHandler published;
+  inputHandler writable;
+  unique_ptr<promise<int>> status;
+  unique_ptr<promise<string>> everything;
+};
+
+static const size_t kMaxEvents = 256;
+
+static void throwManagerError(const string& operation) {
+  throw SubprocessException("SubprocessManager failed to " + operation + " (" + strerror(errno) + ")");
+}
+
+static void makeNonblocking(int fd) {
+  if (fd == kNotInUse) return;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+SubprocessManager::SubprocessManager() : epollfd(epoll_create1(EPOLL_CLOEXEC)), nextSerial(0) {
+  if (epollfd == -1) throwManagerError("create an epoll instance");
+}
+
+SubprocessManager::~SubprocessManager() {
+  for (auto& entry: children) {
+    child& c = *entry.second;
+    for (int fd: {c.pidfd, c.supplyfd, c.ingestfd})
+      if (fd != kNotInUse) close(fd);
+  }
+  close(epollfd);
+}
+
+SubprocessManager::child& SubprocessManager::lookup(pid_t pid) {
+  auto found = serials.find(pid);
+  if (found == serials.end()) throw SubprocessException("SubprocessManager isn't managing process " + to_string(pid));
+  return *children[found->second];
+}
+
+void SubprocessManager::watch(int fd, uint32_t events, uint64_t serial, descriptorKind kind) {
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.u64 = serial << 2 | kind;
+  if (epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event) == -1) throwManagerError("watch a descriptor");
+}
+
+void SubprocessManager::unwatch(int& fd) {
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL);
+  close(fd);
+  fd = kNotInUse;
+}
+
+/**
+ * The pidfd is opened after the child has been spawned, but there's no race: until the manager
+ * reaps it, the child remains a zombie, and a pidfd opened on a zombie is immediately readable.
+ */
+pid_t SubprocessManager::spawn(char *argv[], bool supplyChildInput, bool ingestChildOutput, spawnStrategy strategy) {
+  subprocess_t sp = subprocess(argv, supplyChildInput, ingestChildOutput, strategy);
+  unique_ptr<child> c(new child);
+  c->pid = sp.pid;
+  c->supplyfd = sp.supplyfd;
+  c->ingestfd = sp.ingestfd;
+  c->serial = nextSerial++;
+  c->pidfd = syscall(SYS_pidfd_open, sp.pid, 0);
+  if (c->pidfd == -1) {
+    int err = errno;
+    for (int fd: {sp.supplyfd, sp.ingestfd})
+      if (fd != kNotInUse) close(fd);
+    errno = err;
+    throwManagerError("open a pidfd for process " + to_string(sp.pid));
+  }
+  fcntl(c->pidfd, F_SETFD, FD_CLOEXEC);
+  makeNonblocking(c->supplyfd);
+  makeNonblocking(c->ingestfd);
+  watch(c->pidfd, EPOLLIN, c->serial, kExitDescriptor);
+  if (c->ingestfd != kNotInUse) watch(c->ingestfd, EPOLLIN, c->serial, kOutputDescriptor);
+  if (c->supplyfd != kNotInUse) watch(c->supplyfd, 0, c->serial, kInputDescriptor);
+  serials[c->pid] = c->serial;
+  children[c->serial] = move(c);
+  return sp.pid;
+}
+
+void SubprocessManager::onExit(pid_t pid, const exitHandler& handler) {
+  lookup(pid).exited = handler;
+}
+
+void SubprocessManager::onOutput(pid_t pid, const outputHandler& handler) {
+  lookup(pid).published = handler;
+}
+
+void SubprocessManager::onWritable(pid_t pid, const inputHandler& handler) {
+  child& c = lookup(pid);
+  c.writable = handler;
+  updateInputInterest(c);
+}
+
+future<int> SubprocessManager::exitStatus(pid_t pid) {
+  child& c = lookup(pid);
+  if (c.status) throw SubprocessException("exitStatus may only be called once per process");
+  c.status.reset(new promise<int>);
+  return c.status->get_future();
+}
+
+future<string> SubprocessManager::output(pid_t pid) {
+  child& c = lookup(pid);
+  if (c.everything) throw SubprocessException("output may only be called once per process");
+  c.everything.reset(new promise<string>);
+  c.collectingOutput = true;
+  c.published = nullptr;
+  return c.everything->get_future();
+}
+
+void SubprocessManager::supply(pid_t pid, const string& data) {
+  child& c = lookup(pid);
+  if (c.supplyfd == kNotInUse || c.inputClosing) return;
+  c.pendingInput += data;
+  updateInputInterest(c);
+}
+
+void SubprocessManager::closeInput(pid_t pid) {
+  child& c = lookup(pid);
+  c.inputClosing = true;
+  updateInputInterest(c);
+}
+
+/**
+ * The input descriptor is only watched for writability while there's something to write (or
+ * close), or a handler that wants to know; otherwise, an idle pipe would report itself writable
+ * on every call to epoll_wait.
+ */
+void SubprocessManager::updateInputInterest(child& c) {
+  if (c.supplyfd == kNotInUse) return;
+  if (c.pendingInput.empty() && c.inputClosing) {
+    unwatch(c.supplyfd);
+    retireIfFinished(c.serial);
+    return;
+  }
+  struct epoll_event event = {};
+  event.events = !c.pendingInput.empty() || c.writable ? EPOLLOUT : 0;
+  event.data.u64 = c.serial << 2 | kInputDescriptor;
+  epoll_ctl(epollfd, EPOLL_CTL_MOD, c.supplyfd, &event);
+}
+
+/**
+ * Once a child has exited, nothing will ever read its input, so any input still pending is dropped.
+ */
+void SubprocessManager::handleExit(child& c) {
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(c.pid, &status, WNOHANG)) == -1 && errno == EINTR);
+  if (pid == 0) return; // the pidfd only becomes readable once the child has exited, but just in case
+  if (pid == -1) status = -1; // someone else reaped the child
+  unwatch(c.pidfd);
+  serials.erase(c.pid);
+  if (c.supplyfd != kNotInUse) unwatch(c.supplyfd);
+  if (c.exited) c.exited(status);
+  if (c.status) c.status->set_value(status);
+}
+
+void SubprocessManager::handleOutput(child& c) {
+  char buffer[1 << 16];
+  while (true) {
+    ssize_t count = read(c.ingestfd, buffer, sizeof(buffer));
+    if (count == -1 && errno == EINTR) continue;
+    if (count == -1 && errno == EAGAIN) return;
+    if (count > 0) {
+      if (c.collectingOutput) c.collectedOutput.append(buffer, count);
+      else if (c.published) c.published(buffer, count);
+      continue;
+    }
+
+    unwatch(c.ingestfd);
+    if (c.published) c.published(buffer, 0);
+    if (c.everything) c.everything->set_value(move(c.collectedOutput));
+    return;
+  }
+}
+
+/**
+ * A child that closes its stdin while it's still running leaves the write end of the pipe
+ * reporting EPOLLERR, which can't be masked, so the descriptor is closed straight away
+ * rather than reported on every call to poll until the child exits.
+ */
+void SubprocessManager::handleInput(child& c, uint32_t events) {
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    c.pendingInput.clear();
+    c.inputClosing = true;
+    unwatch(c.supplyfd);
+    return;
+  }
+
+  while (!c.pendingInput.empty()) {
+    ssize_t count = write(c.supplyfd, c.pendingInput.data(), c.pendingInput.size());
+    if (count == -1 && errno == EINTR) continue;
+    if (count == -1 && errno == EAGAIN) return;
+    if (count == -1) { // most likely EPIPE, in which case the child will never read any more
+      c.pendingInput.clear();
+      c.inputClosing = true;
+      break;
+    }
+    c.pendingInput.erase(0, count);
+  }
+
+  // the handler may call closeInput, after which c may already have been forgotten
+  uint64_t serial = c.serial;
+  if (!c.inputClosing && c.writable) c.writable();
+  if (children.count(serial) > 0) updateInputInterest(c);
+}
+
+void SubprocessManager::retireIfFinished(uint64_t serial) {
+  auto found = children.find(serial);
+  if (found == children.end()) return;
+  const child& c = *found->second;
+  if (c.pidfd == kNotInUse && c.supplyfd == kNotInUse && c.ingestfd == kNotInUse) children.erase(found);
+}
+
+/**
+ * Handlers may spawn, supply, or close children, and each event is looked up by the serial number
+ * of its child, so an event for a child that's since been forgotten is simply skipped.
+ */
+size_t SubprocessManager::poll(int timeout) {
+  struct epoll_event events[kMaxEvents];
+  int count;
+  while ((count = epoll_wait(epollfd, events, kMaxEvents, timeout)) == -1 && errno == EINTR);
+  if (count == -1) throwManagerError("wait for events");
+  for (int i = 0; i < count; i++) {
+    uint64_t serial = events[i].data.u64 >> 2;
+    auto found = children.find(serial);
+    if (found == children.end()) continue;
+    child& c = *found->second;
+    switch (events[i].data.u64 & 3) {
+    case kExitDescriptor:
+      if (c.pidfd != kNotInUse) handleExit(c);
+      break;
+    case kOutputDescriptor:
+      if (c.ingestfd != kNotInUse) handleOutput(c);
+      break;
+    case kInputDescriptor:
+      if (c.supplyfd != kNotInUse) handleInput(c, events[i].events);
+      break;
+    }
+    retireIfFinished(serial);
+  }
+  return count;
+}
+
+void SubprocessManager::run() {
+  while (!children.empty()) poll(-1);
+}
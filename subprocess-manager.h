@@ -0,0 +1,141 @@
+/**
+ * File: subprocess-manager.h
+ * --------------------------
+ * Exports the SubprocessManager class, which spawns and drives any number of subprocesses from
+ * a single thread.  Each child's exit is observed through a pidfd (see pidfd_open(2)) rather than
+ * SIGCHLD, and its (nonblocking) supply and ingest descriptors are registered in the same epoll set,
+ * so a single call to epoll_wait learns of every exit, every chunk of output, and every chance to
+ * supply more input, with no signal handlers and so no signal races.
+ *
+ * Sample program, which sorts two lists of words at once:
+
+  SubprocessManager manager;
+  char *sortArgv[] = {const_cast<char *>("sort"), NULL};
+  for (const string& words: {"put\na\nring\n", "on\nit\n"}) {
+    pid_t pid = manager.spawn(sortArgv, true, true);
+    manager.supply(pid, words);
+    manager.closeInput(pid);
+    manager.onOutput(pid, [](const char *data, size_t length) { cout.write(data, length); });
+    manager.onExit(pid, [pid](int status) { cout << pid << " exited" << endl; });
+  }
+  manager.run();
+
+ * Every managed child is reaped by the manager, so nothing else in the process should reap them
+ * (with waitpid(-1, ...), for instance).  Writing to a child that's closed its end of the pipe raises
+ * SIGPIPE, so callers that supply input should ignore SIGPIPE; the manager discards whatever input
+ * remains once that happens.  Each child uses up to three descriptors, so managing thousands of
+ * children may call for raising RLIMIT_NOFILE.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+#include "subprocess.h"
+
+class SubprocessManager {
+ public:
+  /**
+   * Types: exitHandler, outputHandler, inputHandler
+   * -----------------------------------------------
+   * exitHandler is passed the child's status, as waitpid reports it.  outputHandler is passed
+   * each chunk of output as it arrives, and is called one last time with a length of 0 once the
+   * output has ended.  inputHandler is called whenever the child can accept more input and none
+   * is queued, and is expected to call supply (or closeInput, once there's nothing more).
+   */
+  typedef std::function<void(int status)> exitHandler;
+  typedef std::function<void(const char *data, size_t length)> outputHandler;
+  typedef std::function<void()> inputHandler;
+
+  SubprocessManager();
+  ~SubprocessManager();
+
+  /**
+   * Method: spawn
+   * -------------
+   * Spawns a child just as subprocess does, and takes over managing it.  Returns its pid.
+   */
+  pid_t spawn(char *argv[], bool supplyChildInput, bool ingestChildOutput, spawnStrategy strategy = kPosixSpawn);
+
+  /**
+   * Methods: onExit, onOutput, onWritable
+   * -------------------------------------
+   * Install the handler to call when the specified child exits, publishes output, or can
+   * accept more input.  Handlers are only ever called from within poll and run, so
+   * installing them any time before the next of those calls never misses an event.
+   */
+  void onExit(pid_t pid, const exitHandler& handler);
+  void onOutput(pid_t pid, const outputHandler& handler);
+  void onWritable(pid_t pid, const inputHandler& handler);
+
+  /**
+   * Methods: exitStatus, output
+   * ---------------------------
+   * Return futures for the specified child's status and for everything it publishes,
+   * which become ready once it exits and once its output ends, respectively.  Each may
+   * be called at most once per child, and output replaces any outputHandler.
+   */
+  std::future<int> exitStatus(pid_t pid);
+  std::future<std::string> output(pid_t pid);
+
+  /**
+   * Methods: supply, closeInput
+   * ---------------------------
+   * supply queues the supplied bytes to be written to the child's stdin as it can accept them,
+   * and closeInput arranges for its stdin to be closed once everything queued has been written.
+   */
+  void supply(pid_t pid, const std::string& data);
+  void closeInput(pid_t pid);
+
+  /**
+   * Method: poll
+   * ------------
+   * Waits up to the specified number of milliseconds (or indefinitely, if -1) for something to
+   * happen to any child, and handles whatever did.  Returns the number of events handled.
+   */
+  size_t poll(int timeout);
+
+  /**
+   * Method: run
+   * -----------
+   * Handles events until every child has exited and published all of its output.
+   */
+  void run();
+
+  /**
+   * Method: size
+   * ------------
+   * Returns the number of children whose exit, output, or input is still being managed.
+   */
+  size_t size() const { return children.size(); }
+
+ private:
+  struct child;
+  enum descriptorKind {
+    kExitDescriptor,
+    kOutputDescriptor,
+    kInputDescriptor
+  };
+
+  child& lookup(pid_t pid);
+  void watch(int fd, uint32_t events, uint64_t serial, descriptorKind kind);
+  void unwatch(int& fd);
+  void updateInputInterest(child& c);
+  void handleExit(child& c);
+  void handleOutput(child& c);
+  void handleInput(child& c, uint32_t events);
+  void retireIfFinished(uint64_t serial);
+
+  int epollfd;
+  uint64_t nextSerial;
+  std::unordered_map<uint64_t, std::unique_ptr<child>> children; // keyed by serial number, which unlike descriptors is never reused
+  std::unordered_map<pid_t, uint64_t> serials;
+
+  SubprocessManager(const SubprocessManager& other) = delete;
+  SubprocessManager& operator=(const SubprocessManager& rhs) = delete;
+};
@@ -0,0 +1,149 @@
+/**
+ * File: subprocess-pump-test.cc
+ * -----------------------------
+ * Exercises pump: streams far more than a pipe's worth of data through cat (which deadlocks if
+ * the input is written before the output is read), round-trips text through gzip and gunzip,
+ * sorts a large input, feeds a child that exits before reading all of its input, and has a
+ * sink throw after a child stops reading.  SIGPIPE is deliberately left at its default
+ * disposition, so those last two tests also confirm pump keeps it from killing the process.
+ * A nonzero exit status means some child's output wasn't what it should have been.
+ */
+
+#include "subprocess-pump.h"
+#include "test-utils.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <sys/wait.h>
+using namespace std;
+
+static const size_t kStreamBytes = 1 << 30;
+static const size_t kNumLines = 1000000;
+static const char *const kCat[] = {"cat", NULL};
+static const char *const kCompressor[] = {"gzip", "-c", NULL};
+static const char *const kDecompressor[] = {"gzip", "-dc", NULL};
+static const char *const kSorter[] = {"env", "LC_ALL=C", "sort", NULL}; // so it sorts as std::sort does
+static const char *const kQuitter[] = {"head", "-c", "10", NULL};
+static const char *const kLateComplainer[] = {"sh", "-c", "head -c 10 >/dev/null; exec 0<&-; sleep 0.2; echo x", NULL};
+
+static int waitForChild(const subprocess_t& child) {
+  int status;
+  waitpid(child.pid, &status, 0);
+  return status;
+}
+
+static bool exitedCleanly(const subprocess_t& child) {
+  int status = waitForChild(child);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Function: runThrough
+ * --------------------
+ * Pumps input through a child running the supplied argument vector, and returns its output.
+ */
+static string runThrough(const char *const argv[], const string& input, bool& succeeded) {
+  subprocess_t child = subprocess(const_cast<char **>(argv), true, true);
+  string output;
+  pump(child, input, [&output](const char *data, size_t length) { output.append(data, length); });
+  succeeded = exitedCleanly(child) && succeeded;
+  return output;
+}
+
+static string numberedLines(bool reversed) {
+  vector<string> lines;
+  for (size_t i = 0; i < kNumLines; i++) lines.push_back("line " + to_string(i) + "\n");
+  sort(lines.begin(), lines.end());
+  if (reversed) reverse(lines.begin(), lines.end());
+  string text;
+  for (const string& line: lines) text += line;
+  return text;
+}
+
+/**
+ * Function: testStream
+ * --------------------
+ * Streams a gigabyte through cat, produced and consumed a buffer at a time, so that neither the
+ * input nor the output is ever held in memory, and reports the throughput.
+ */
+static bool testStream() {
+  // byte i of the stream is i % 251, so any chunk of it can be copied out of (or compared against) pattern
+  vector<char> pattern(kDefaultPumpBufferSize + 251);
+  for (size_t i = 0; i < pattern.size(); i++) pattern[i] = char(i % 251);
+  subprocess_t child = subprocess(const_cast<char **>(kCat), true, true);
+  size_t produced = 0, consumed = 0;
+  bool intact = true;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  pump(child, [&pattern, &produced](char *buffer, size_t capacity) -> size_t {
+    size_t count = min(capacity, kStreamBytes - produced);
+    memcpy(buffer, pattern.data() + produced % 251, count);
+    produced += count;
+    return count;
+  }, [&pattern, &consumed, &intact](const char *data, size_t length) {
+    intact = intact && memcmp(data, pattern.data() + consumed % 251, length) == 0;
+    consumed += length;
+  });
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  bool passed = check("stream 1GB through cat", exitedCleanly(child) && intact && consumed == kStreamBytes);
+  cout << "    " << fixed << setprecision(0) << kStreamBytes / seconds / (1 << 20) << " MB/s" << endl;
+  return passed;
+}
+
+static bool testCompression(const string& text) {
+  bool succeeded = true;
+  string compressed = runThrough(kCompressor, text, succeeded);
+  string decompressed = runThrough(kDecompressor, compressed, succeeded);
+  return check("round-trip text through gzip", succeeded && compressed.size() < text.size() && decompressed == text);
+}
+
+static bool testSort(const string& sorted) {
+  bool succeeded = true;
+  string output = runThrough(kSorter, numberedLines(true), succeeded);
+  return check("sort " + to_string(kNumLines) + " lines", succeeded && output == sorted);
+}
+
+static bool testQuitter(const string& text) {
+  bool succeeded = true;
+  string output = runThrough(kQuitter, text, succeeded);
+  return check("feed a child that quits early", succeeded && output == text.substr(0, 10));
+}
+
+/**
+ * Function: testThrowingSink
+ * --------------------------
+ * Feeds a child that stops reading its input (so pump raises SIGPIPE) and only then publishes
+ * output, to a sink that throws.  The exception should reach the caller, and the SIGPIPE
+ * shouldn't, even though pump leaves by way of the exception.
+ */
+static bool testThrowingSink(const string& text) {
+  subprocess_t child = subprocess(const_cast<char **>(kLateComplainer), true, true);
+  bool caught = false;
+  try {
+    pump(child, text, [](const char *data, size_t length) {
+      throw SubprocessException("the sink refuses all output");
+    });
+  } catch (const SubprocessException& se) {
+    caught = true;
+  }
+  return check("throw from the sink after the child stops reading", exitedCleanly(child) && caught);
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    cout << "Testing pump." << endl;
+    string sorted = numberedLines(false);
+    bool passed = testStream();
+    passed = testCompression(sorted) && passed;
+    passed = testSort(sorted) && passed;
+    passed = testQuitter(sorted) && passed;
+    passed = testThrowingSink(sorted) && passed;
+    return passed ? 0 : 1;
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while pumping: " << se.what() << endl;
+    return 1;
+  }
+}
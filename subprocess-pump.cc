@@ -0,0 +1,161 @@
+/**
+ * File: subprocess-pump.cc
+ * ------------------------
+ * Presents the implementation of the pump routines exported by subprocess-pump.h.
+ */
+
+#include "subprocess-pump.h"
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+using namespace std;
+
+static void throwPumpError(const string& operation) {
+  throw SubprocessException("pump failed to " + operation + " (" + strerror(errno) + ")");
+}
+
+static void makeNonblocking(int fd) {
+  if (fd == kNotInUse) return;
+  int flags = fcntl(fd, F_GETFL);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) throwPumpError("make a descriptor nonblocking");
+}
+
+static void closeDescriptor(int& fd) {
+  if (fd == kNotInUse) return;
+  close(fd);
+  fd = kNotInUse;
+}
+
+/**
+ * Function: supplySome
+ * --------------------
+ * Writes as much of the pending input as the child will accept without blocking, and advances
+ * start past it.  Returns false if the child has closed its stdin, in which case nothing more
+ * should be written.
+ */
+static bool supplySome(int fd, const vector<char>& input, size_t& start, size_t end) {
+  while (start < end) {
+    ssize_t count = write(fd, input.data() + start, end - start);
+    if (count == -1 && errno == EINTR) continue;
+    if (count == -1 && errno == EAGAIN) return true;
+    if (count == -1 && errno == EPIPE) return false;
+    if (count == -1) throwPumpError("write to the child");
+    start += count;
+  }
+  return true;
+}
+
+/**
+ * Function: ingestSome
+ * --------------------
+ * Reads one buffer's worth of output, if any is ready, and hands it to the sink.  Returns false
+ * once the child's output has ended.  Reading only once per call keeps a prolific child from
+ * starving its own input.
+ */
+static bool ingestSome(int fd, vector<char>& output, const pumpSink& sink) {
+  while (true) {
+    ssize_t count = read(fd, output.data(), output.size());
+    if (count == -1 && errno == EINTR) continue;
+    if (count == -1 && errno == EAGAIN) return true;
+    if (count == -1) throwPumpError("read from the child");
+    if (count == 0) return false;
+    sink(output.data(), count);
+    return true;
+  }
+}
+
+static void pumpAll(subprocess_t& child, const pumpSource& source, const pumpSink& sink,
+                    size_t bufferSize, bool& pipeBroken) {
+  makeNonblocking(child.supplyfd);
+  makeNonblocking(child.ingestfd);
+  vector<char> input(child.supplyfd == kNotInUse ? 0 : bufferSize);
+  vector<char> output(child.ingestfd == kNotInUse ? 0 : bufferSize);
+  size_t start = 0, end = 0; // the input produced by the source, but not yet written
+  while (child.supplyfd != kNotInUse || child.ingestfd != kNotInUse) {
+    // the source is only asked for more once everything it last produced has been written
+    if (child.supplyfd != kNotInUse && start == end) {
+      start = 0;
+      end = source(input.data(), input.size());
+      if (end == 0) closeDescriptor(child.supplyfd);
+    }
+
+    struct pollfd fds[2];
+    nfds_t numfds = 0;
+    if (child.supplyfd != kNotInUse) fds[numfds++] = {child.supplyfd, POLLOUT, 0};
+    if (child.ingestfd != kNotInUse) fds[numfds++] = {child.ingestfd, POLLIN, 0};
+    if (numfds == 0) break;
+    if (poll(fds, numfds, -1) == -1) {
+      if (errno == EINTR) continue;
+      throwPumpError("poll the child's descriptors");
+    }
+
+    for (nfds_t i = 0; i < numfds; i++) {
+      if (fds[i].revents == 0) continue;
+      if (fds[i].fd == child.supplyfd && !supplySome(child.supplyfd, input, start, end)) {
+        pipeBroken = true;
+        start = end = 0;
+        closeDescriptor(child.supplyfd);
+      } else if (fds[i].fd == child.ingestfd && !ingestSome(child.ingestfd, output, sink)) {
+        closeDescriptor(child.ingestfd);
+      }
+    }
+  }
+}
+
+/**
+ * Function: restoreSignalMask
+ * ---------------------------
+ * Accepts the SIGPIPE pump raised, if it raised one, and then restores the mask pump replaced.
+ * Called whether pump returns or throws, since a SIGPIPE left pending would be delivered (and
+ * kill the caller) the moment the mask was restored.
+ */
+static void restoreSignalMask(const sigset_t& pipeMask, const sigset_t& previousMask, bool acceptPipeSignal) {
+  if (acceptPipeSignal) {
+    struct timespec immediately = {0, 0};
+    sigtimedwait(&pipeMask, NULL, &immediately);
+  }
+  pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+}
+
+/**
+ * SIGPIPE is blocked rather than ignored, since the disposition is shared by every thread in the
+ * process.  A SIGPIPE that pump raises stays pending until it's accepted by sigtimedwait, which is
+ * only done if one wasn't already pending beforehand, so that none meant for the caller is lost.
+ */
+void pump(subprocess_t& child, const pumpSource& source, const pumpSink& sink,
+          size_t bufferSize) throw (SubprocessException) {
+  if (bufferSize == 0) throw SubprocessException("pump needs a nonempty buffer");
+  sigset_t pipeMask, previousMask, pending;
+  sigemptyset(&pipeMask);
+  sigaddset(&pipeMask, SIGPIPE);
+  sigpending(&pending);
+  bool alreadyPending = sigismember(&pending, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeMask, &previousMask);
+
+  bool pipeBroken = false; // set by pumpAll as soon as it happens, so it's accurate even if pumpAll throws
+  try {
+    pumpAll(child, source, sink, bufferSize, pipeBroken);
+  } catch (...) {
+    closeDescriptor(child.supplyfd);
+    closeDescriptor(child.ingestfd);
+    restoreSignalMask(pipeMask, previousMask, pipeBroken && !alreadyPending);
+    throw;
+  }
+  restoreSignalMask(pipeMask, previousMask, pipeBroken && !alreadyPending);
+}
+
+void pump(subprocess_t& child, const string& input, const pumpSink& sink,
+          size_t bufferSize) throw (SubprocessException) {
+  size_t offset = 0;
+  pump(child, [&input, &offset](char *buffer, size_t capacity) -> size_t {
+    size_t count = min(capacity, input.size() - offset);
+    memcpy(buffer, input.data() + offset, count);
+    offset += count;
+    return count;
+  }, sink, bufferSize);
+}
@@ -0,0 +1,73 @@
+/**
+ * File: subprocess-pump.h
+ * -----------------------
+ * Exports pump, which feeds a subprocess its input and collects its output at the same time.
+ *
+ * The sample program in subprocess.h publishes everything to the child before reading anything
+ * back, which works for sort (which reads all of its input before writing any output) but not for
+ * a streaming filter like cat, tr, or gzip: once the filter has written a pipe's worth of output
+ * that nobody is reading, it blocks, stops reading its input, and the parent blocks too.  pump
+ * instead makes both descriptors nonblocking and services whichever one poll says is ready, so
+ * neither side ever waits on the other.
+ *
+ * Sample program, which compresses a large string with gzip:
+
+  char *argv[] = {const_cast<char *>("gzip"), const_cast<char *>("-c"), NULL};
+  subprocess_t child = subprocess(argv, true, true);
+  string compressed;
+  pump(child, text, [&compressed](const char *data, size_t length) { compressed.append(data, length); });
+  waitpid(child.pid, NULL, 0);
+
+ * Only a bounded amount of either stream is ever held in memory: the source is asked for more
+ * input only once what it last produced has been written, and output is handed to the sink a
+ * buffer at a time, as it's read.  A slow sink therefore slows the child, and a slow child slows
+ * the source, which is what lets gigabytes stream through at the speed of the slowest stage.
+ */
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "subprocess.h"
+
+/**
+ * Types: pumpSource, pumpSink
+ * ---------------------------
+ * A pumpSource fills the supplied buffer with up to capacity bytes of the child's input and
+ * returns how many it produced, or 0 once there's no more input.  A pumpSink is passed each
+ * chunk of the child's output as it arrives.
+ */
+typedef std::function<size_t(char *buffer, size_t capacity)> pumpSource;
+typedef std::function<void(const char *data, size_t length)> pumpSink;
+
+/**
+ * Constant: kDefaultPumpBufferSize
+ * --------------------------------
+ * The default size of each of pump's two buffers, which matches the default capacity of a pipe.
+ */
+static const size_t kDefaultPumpBufferSize = 1 << 16;
+
+/**
+ * Function: pump
+ * --------------
+ * Supplies the child everything the source produces and publishes everything the child writes to
+ * the sink, until the source is exhausted and the child's output has ended, and then closes both of
+ * the child's descriptors (either of which may be kNotInUse).  The child is not waited on.
+ *
+ * Should the child close its stdin before accepting all of its input, the remainder is discarded and
+ * its output is still collected.  SIGPIPE is blocked in the calling thread while pump runs, and any
+ * SIGPIPE raised by writing to such a child is discarded, so callers needn't ignore SIGPIPE.
+ *
+ * If the source or sink throws a SubprocessException, both descriptors are closed and the exception
+ * propagates.
+ */
+void pump(subprocess_t& child, const pumpSource& source, const pumpSink& sink,
+          size_t bufferSize = kDefaultPumpBufferSize) throw (SubprocessException);
+
+/**
+ * Function: pump
+ * --------------
+ * A convenience that supplies the child the contents of input.
+ */
+void pump(subprocess_t& child, const std::string& input, const pumpSink& sink,
+          size_t bufferSize = kDefaultPumpBufferSize) throw (SubprocessException);
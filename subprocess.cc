@@ -5,6 +5,10 @@
  */
 
 #include "subprocess.h"
+#include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
 #include "fork-utils.h" // this has to be the very last #include statement in this .cc file!
 using namespace std;
 
@@ -14,12 +18,13 @@ void try_close(int fd);
 void try_dup2(int fd, int fd1);
 
 
-subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput) throw (SubprocessException) {
-
-  int fds1[2];
-  int fds2[2];
-  pipe(fds1);
-  pipe(fds2);
+/**
+ * Function: forkSubprocess
+ * ------------------------
+ * The traditional implementation: fork, rewire the child's descriptors, and execvp.
+ * If argv[0] can't be executed, the child exits with status 127.
+ */
+static subprocess_t forkSubprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput, int fds1[], int fds2[]) {
   subprocess_t sp = {fork(), kNotInUse, kNotInUse};
 
   if (sp.pid == 0){
@@ -29,21 +34,60 @@ subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOut
     try_close(fds1[0]);
     try_close(fds1[1]);
     if (ingestChildOutput) {
-      try_dup2(fds2[0], STDIN_FILENO);
+      try_dup2(fds2[1], STDOUT_FILENO);
     }
     try_close(fds2[0]);
     try_close(fds2[1]);
 
     try_execvp(argv[0], argv);
+    _exit(127); // argv[0] couldn't be executed, and the child mustn't return into its parent's code
+  }
+  return sp;
+}
+
+/**
+ * Function: spawnSubprocess
+ * -------------------------
+ * Hands the rewiring to posix_spawnp as a list of file actions.  Every pipe descriptor is
+ * close-on-exec, so only the dup2'ed copies survive into the child.  glibc reports a failed
+ * exec (and any other failure) as posix_spawnp's return value, so it's surfaced as an exception.
+ */
+static subprocess_t spawnSubprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput, int fds1[], int fds2[]) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (supplyChildInput) posix_spawn_file_actions_adddup2(&actions, fds1[0], STDIN_FILENO);
+  if (ingestChildOutput) posix_spawn_file_actions_adddup2(&actions, fds2[1], STDOUT_FILENO);
+  subprocess_t sp = {-1, kNotInUse, kNotInUse};
+  int err = posix_spawnp(&sp.pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    for (int fd: {fds1[0], fds1[1], fds2[0], fds2[1]}) close(fd);
+    throw SubprocessException("failed to execute the command (" + string(strerror(err)) + ")");
+  }
+  return sp;
+}
+
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput, spawnStrategy strategy) throw (SubprocessException) {
+
+  // both pipes are close-on-exec so that no other child inherits them (which would keep the
+  // child from ever seeing the end of its input); dup2 clears the flag on the child's copies
+  int fds1[2];
+  int fds2[2];
+  pipe2(fds1, O_CLOEXEC);
+  pipe2(fds2, O_CLOEXEC);
+  subprocess_t sp = strategy == kForkExec ? forkSubprocess(argv, supplyChildInput, ingestChildOutput, fds1, fds2)
+                                          : spawnSubprocess(argv, supplyChildInput, ingestChildOutput, fds1, fds2);
+  try_close(fds1[0]);
+  try_close(fds2[1]);
+  if (supplyChildInput) {
+    sp.supplyfd = fds1[1];
   } else {
-    try_close(fds1[0]);
-    try_close(fds2[1]);
-    if (supplyChildInput) {
-      sp.supplyfd = fds1[1];
-    }
-    if (ingestChildOutput) {
-      sp.ingestfd =  fds2[0];
-    }
+    try_close(fds1[1]);
+  }
+  if (ingestChildOutput) {
+    sp.ingestfd =  fds2[0];
+  } else {
+    try_close(fds2[0]);
   }
   return sp;
 }
@@ -49,6 +49,10 @@ int main(int argc, char *argv[]) {
   }
 }
 
+ * The program above publishes all of its input before reading any output, which only works because
+ * sort reads all of its input before publishing anything.  A child that streams its output (cat, tr,
+ * gzip) blocks once it's filled the pipe to its parent, and stops reading its input, so the parent
+ * blocks too.  pump, exported by subprocess-pump.h, feeds and drains such a child at the same time.
  */
 
 #pragma once
@@ -83,6 +87,20 @@ struct subprocess_t {
   int ingestfd;
 };
  
+/**
+ * Type: spawnStrategy
+ * -------------------
+ * kPosixSpawn creates the child with posix_spawnp, which glibc implements with
+ * clone(CLONE_VM | CLONE_VFORK): the child borrows the parent's address space until it execs,
+ * so no page tables are copied, and spawning costs the same no matter how large the parent is.
+ * kForkExec is the traditional fork and execvp, whose cost grows with the parent's address space.
+ * subprocess-benchmark compares the two.
+ */
+enum spawnStrategy {
+  kPosixSpawn,
+  kForkExec
+};
+ 
 /**
  * Function: subprocess
  * --------------------
@@ -91,6 +109,11 @@ struct subprocess_t {
  *   argv: the NULL-terminated argument vector that should be passed to the new process's main function
  *   supplyChildInput: true if the parent process would like to pipe content to the new process's stdin, false otherwise
  *   ingestChildOutput: true if the parent would like the child's stdout to be pushed to the parent, false otheriwse
+ *   strategy: how the child should be created (see spawnStrategy above)
+ *
+ * With kPosixSpawn, an argv[0] that can't be executed raises a SubprocessException.  With kForkExec,
+ * the child is created regardless, and exits with status 127.
  */
-subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput) throw (SubprocessException);
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput,
+                        spawnStrategy strategy = kPosixSpawn) throw (SubprocessException);
 
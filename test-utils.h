@@ -0,0 +1,21 @@
+/**
+ * File: test-utils.h
+ * ------------------
+ * Defines the helper shared by the test programs that check their own results (relay-test,
+ * subprocess-manager-test, and subprocess-pump-test) rather than leaving them to be inspected.
+ */
+
+#pragma once
+#include <iostream>
+#include <string>
+
+/**
+ * Function: check
+ * ---------------
+ * Prints the supplied description of a test along with whether it passed, and
+ * returns passed so that callers can accumulate an overall result.
+ */
+inline bool check(const std::string& description, bool passed) {
+  std::cout << "  " << description << ": " << (passed ? "passed" : "FAILED") << std::endl;
+  return passed;
+}
@@ -0,0 +1,120 @@
+/**
+ * File: trace-decode.cc
+ * ---------------------
+ * Presents the implementation of the trace-decode program, which renders the binary records
+ * published by trace --output-format=binary as the very same text trace would have printed
+ * had it been run without that flag.  Recording in binary and decoding later means the
+ * traced program only pays for the recording, e.g.
+ *
+ *    > ./trace --output-format=binary --output=find.trace find /usr/include -name *.h
+ *    > ./trace-decode find.trace
+ *
+ * trace-decode accepts the following flags ahead of the (optional) file name, and reads
+ * the records from standard input if no file name is supplied:
+ *
+ *    --simple       prints system call numbers instead of names and arguments, as with trace --simple
+ *    --timestamps   prefixes each line with the time the system call was made
+ *    --rebuild      rebuilds the system call tables from scratch instead of using the compiled-in ones, as with trace --rebuild
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <unistd.h>
+#include "trace-system-calls.h"
+#include "trace-error-constants.h"
+#include "trace-static-tables.h"
+#include "trace-record.h"
+#include "trace-format.h"
+#include "trace-output.h"
+#include "trace-exception.h"
+#include "string-utils.h"
+using namespace std;
+
+static const string kSimpleFlag = "--simple";
+static const string kTimestampsFlag = "--timestamps";
+static const string kRebuildFlag = "--rebuild";
+
+/**
+ * Function: printTimestamp
+ * ------------------------
+ * Prints the supplied number of nanoseconds since the epoch as seconds.microseconds.
+ */
+static void printTimestamp(TraceOutput& out, uint64_t timestamp) {
+  uint64_t microseconds = (timestamp / 1000) % 1000000;
+  out.putDecimal(timestamp / 1000000000).put('.');
+  for (uint64_t place = 100000; place > microseconds && place > 1; place /= 10) out.put('0');
+  out.putDecimal(microseconds).put(' ');
+}
+
+/**
+ * Function: decodeTraceRecords
+ * ----------------------------
+ * Reads and renders every record in the supplied stream.
+ */
+static void decodeTraceRecords(istream& in, TraceOutput& out, systemCallTable& systemCalls,
+                               const map<int, string>& errorConstants, bool simple, bool timestamps) {
+  uint32_t version = readTraceFileHeader(in);
+  traceEvent event;
+  traceRecordType type;
+  while (readTraceRecord(in, version, type, event)) {
+    if (timestamps) printTimestamp(out, event.timestamp);
+    if (type == kExitRecord) {
+      printProcessExit(out, event.retval);
+      continue;
+    }
+
+    resolveSystemCall(systemCalls, event.number);
+    if (event.concurrent) printThreadPrefix(out, event.pid);
+    printSystemCall(out, event, systemCalls, simple);
+    if (event.returned) {
+      printSystemCallReturn(out, event, systemCalls, simple, errorConstants);
+    } else {
+      out.put("= <no return>").endLine();
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool simple = false, timestamps = false, rebuild = false;
+  int i = 1;
+  for (; argv[i] != NULL && startsWith(argv[i], "--"); i++) {
+    if (argv[i] == kSimpleFlag) simple = true;
+    else if (argv[i] == kTimestampsFlag) timestamps = true;
+    else if (argv[i] == kRebuildFlag) rebuild = true;
+    else {
+      cerr << argv[0] << ": Unrecognized flag (" << argv[i] << " )" << endl;
+      return 1;
+    }
+  }
+
+  systemCallTable systemCalls;
+  if (rebuild || !loadStaticSystemCallTable(systemCalls))
+    compileSystemCallTable(systemCalls, rebuild, rebuild ? kEagerResolution : kLazyResolution);
+
+  map<int, string> errorConstants;
+  try {
+    if (rebuild || !loadStaticErrorConstants(errorConstants))
+      compileSystemCallErrorStrings(errorConstants);
+  } catch (MissingFileException& e) {
+    cerr << e.what() << endl;
+  }
+
+  TraceOutput out(STDOUT_FILENO, isatty(STDOUT_FILENO) ? kFlushLine : kFlushBlock);
+  try {
+    if (argv[i] == NULL) {
+      decodeTraceRecords(cin, out, systemCalls, errorConstants, simple, timestamps);
+    } else {
+      ifstream infile(argv[i], ios::binary);
+      if (infile.fail()) throw MissingFileException("Failed to open the file named \"" + string(argv[i]) + "\".");
+      decodeTraceRecords(infile, out, systemCalls, errorConstants, simple, timestamps);
+    }
+  } catch (const TraceException& te) {
+    out.flush();
+    cerr << argv[0] << ": " << te.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * File: trace-filter.cc
+ * ---------------------
+ * Presents the implementation of installSystemCallFilter.  The BPF program generated
+ * for numbers = {257, 42} looks like this:
+ *
+ *     load arch                  ; bail on anything other than x86_64
+ *     if arch != x86_64 goto allow
+ *     load nr
+ *     if nr == 257 goto trace
+ *     if nr == 42 goto trace
+ *   allow:
+ *     return SECCOMP_RET_ALLOW
+ *   trace:
+ *     return SECCOMP_RET_TRACE
+ */
+
+#include "trace-filter.h"
+#include <cstddef>
+#include <sys/prctl.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+using namespace std;
+
+bool installSystemCallFilter(const vector<int>& numbers) {
+  size_t numChecks = numbers.size();
+  if (numChecks > kMaxFilteredSystemCalls) return false;
+  unsigned char distanceToAllow = numChecks + 1; // skip the load of nr and all of the checks
+  vector<sock_filter> program;
+  program.push_back((sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)));
+  program.push_back((sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, distanceToAllow));
+  program.push_back((sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+  for (size_t i = 0; i < numChecks; i++) {
+    unsigned char distanceToTrace = numChecks - i; // skip the remaining checks and the allow
+    program.push_back((sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, numbers[i], distanceToTrace, 0));
+  }
+  program.push_back((sock_filter) BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+  program.push_back((sock_filter) BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+
+  sock_fprog fprog = {(unsigned short) program.size(), program.data()};
+  if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1) return false;
+  return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) == 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * File: trace-filter.h
+ * --------------------
+ * Exports the routine that installs the seccomp BPF program trace --filter relies on.
+ * The program asks the kernel to stop the tracee (via PTRACE_EVENT_SECCOMP) before
+ * the system calls of interest, and lets all other system calls run without stopping
+ * the tracee at all.  The filter is inherited across fork, clone, and execve, so
+ * it only needs to be installed once, in the process trace launches.
+ */
+
+#pragma once
+#include <vector>
+#include <cstddef>
+
+/**
+ * Constant: kMaxFilteredSystemCalls
+ * ---------------------------------
+ * BPF conditional jumps can only skip 255 instructions, which limits the number of
+ * system calls a single filter can single out.
+ */
+static const size_t kMaxFilteredSystemCalls = 250;
+
+/**
+ * Function: installSystemCallFilter
+ * ---------------------------------
+ * Installs a seccomp filter that returns SECCOMP_RET_TRACE for each of the supplied
+ * system call numbers and SECCOMP_RET_ALLOW for everything else.  Must be called by the
+ * tracee itself, after the tracer has set PTRACE_O_TRACESECCOMP.  Returns true if and
+ * only if the filter was installed (which can't happen if there are more than
+ * kMaxFilteredSystemCalls numbers).
+ */
+bool installSystemCallFilter(const std::vector<int>& numbers);
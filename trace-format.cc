@@ -0,0 +1,89 @@
+/**
+ * File: trace-format.cc
+ * ---------------------
+ * Presents the implementation of the text rendering routines exported by trace-format.h.
+ */
+
+#include "trace-format.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <sys/wait.h>
+using namespace std;
+
+/**
+ * Function: printPointer
+ * ----------------------
+ * Prints NULL pointers as NULL, and everything else in hex.
+ */
+static void printPointer(TraceOutput& out, unsigned long value) {
+  (value == 0) ? out.put("NULL") : out.put("0x").putHex(value);
+}
+
+void printThreadPrefix(TraceOutput& out, pid_t tid) {
+  out.put("[pid ").putDecimal(tid).put("] ");
+}
+
+void printSystemCall(TraceOutput& out, const traceEvent& event, const systemCallTable& systemCalls, bool simple) {
+  if (simple) {
+    out.put("syscall(").putDecimal(event.number).put(") ");
+    return;
+  }
+
+  const systemCallEntry& entry = lookupSystemCall(systemCalls, event.number);
+  out.put(systemCallName(systemCalls, event.number)).put('(');
+  for (size_t index = 0; index < entry.numArguments; index++) {
+    enum scParamType signature = scParamType(entry.parameters[index]);
+    assert(signature != SYSCALL_UNKNOWN_TYPE);
+    if (index > 0) out.put(", ");
+
+    switch(signature) {
+    case SYSCALL_INTEGER:
+      out.putDecimal(long(event.args[index]));
+      break;
+    case SYSCALL_STRING:
+      if (event.captured[index] == kNotCaptured) {
+        printPointer(out, event.args[index]);
+        break;
+      }
+      out.put('"').put(event.strings[index]).put('"');
+      if (event.captured[index] == kTruncated) out.put("...");
+      break;
+    default:
+      printPointer(out, event.args[index]);
+      break;
+    }
+  }
+  out.put(") ");
+}
+
+void printSystemCallReturn(TraceOutput& out, const traceEvent& event, const systemCallTable& systemCalls, bool simple,
+                           const map<int, string>& errorConstants) {
+  long ret = event.retval;
+  out.put("= ");
+  if (simple) {
+    out.putDecimal(ret).endLine();
+    return;
+  }
+  if (ret < 0) {
+    auto found = errorConstants.find(abs(ret));
+    out.put("-1 ").put(found == errorConstants.cend() ? "" : found->second.c_str());
+    out.put(" (").put(strerror(abs(ret))).put(')').endLine();
+    return;
+  }
+
+  if (lookupSystemCall(systemCalls, event.number).returnType == SYSCALL_POINTER) {
+    out.put("0x").putHex(ret).endLine();
+    return;
+  }
+
+  out.putDecimal(ret).endLine();
+}
+
+void printProcessExit(TraceOutput& out, int status) {
+  if (WIFSIGNALED(status)) {
+    out.put("Program terminated by signal ").putDecimal(WTERMSIG(status)).put(" (").put(strsignal(WTERMSIG(status))).put(')').endLine();
+  } else {
+    out.put("Program exited normally with status ").putDecimal(WEXITSTATUS(status)).endLine();
+  }
+}
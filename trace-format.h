@@ -0,0 +1,46 @@
+/**
+ * File: trace-format.h
+ * --------------------
+ * Exports the routines that render traceEvents as text.  They're shared by trace,
+ * which renders events as they happen, and trace-decode, which renders events
+ * recorded by trace --output-format=binary.
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include "trace-record.h"
+#include "trace-system-calls.h"
+#include "trace-output.h"
+
+/**
+ * Function: printThreadPrefix
+ * ---------------------------
+ * Prints the "[pid 1234] " prefix that identifies which thread made a system call.
+ */
+void printThreadPrefix(TraceOutput& out, pid_t tid);
+
+/**
+ * Function: printSystemCall
+ * -------------------------
+ * Prints the name and arguments of the system call described by event, as with
+ * "openat(-100, "/etc/passwd", 0, 0) ", or "syscall(257) " when simple is true.  String
+ * arguments that weren't captured are printed as pointers.
+ */
+void printSystemCall(TraceOutput& out, const traceEvent& event, const systemCallTable& systemCalls, bool simple);
+
+/**
+ * Function: printSystemCallReturn
+ * -------------------------------
+ * Prints the return value of the system call described by event, as with "= 3" or
+ * "= -1 ENOENT (No such file or directory)", and ends the line.
+ */
+void printSystemCallReturn(TraceOutput& out, const traceEvent& event, const systemCallTable& systemCalls, bool simple,
+                           const std::map<int, std::string>& errorConstants);
+
+/**
+ * Function: printProcessExit
+ * --------------------------
+ * Prints the line reporting how the traced program terminated, given its raw waitpid status.
+ */
+void printProcessExit(TraceOutput& out, int status);
@@ -0,0 +1,115 @@
+/**
+ * File: trace-generate-tables.cc
+ * ------------------------------
+ * Presents the implementation of trace-generate-tables, the build tool that writes the
+ * trace-generated-tables.h header compiled into trace and trace-decode.  It compiles the
+ * system call table exactly as trace --rebuild would (relying on the signature cache when it's
+ * current) along with the errno constants, and then emits both as constexpr arrays, e.g.
+ *
+ *    > ./trace-generate-tables trace-generated-tables.h
+ *
+ * If unistd_64.h or the errno headers can't be read, the corresponding tables are emitted empty,
+ * and trace falls back on parsing the headers at runtime.  The same goes for the system call
+ * table if no signatures could be found (because the kernel sources aren't installed, say),
+ * since a table of bare names would otherwise keep trace from ever looking for them.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include "trace-system-calls.h"
+#include "trace-error-constants.h"
+#include "trace-exception.h"
+using namespace std;
+
+/**
+ * Function: writeSystemCallTable
+ * ------------------------------
+ * Writes the entries and names of the supplied table.  Names are renumbered as they're
+ * written, since the table may have been mapped from the cache and its names can only
+ * be reached through its entries.
+ */
+static void writeSystemCallTable(ostream& out, const systemCallTable& table) {
+  out << "constexpr systemCallEntry kGeneratedSystemCallEntries[] = {" << endl;
+  uint32_t nameOffset = 1; // offset 0 is the empty name shared by all unknown numbers
+  for (size_t number = 0; number < table.numEntries; number++) {
+    const systemCallEntry& entry = table.entries[number];
+    const char *name = table.names + entry.nameOffset;
+    out << "  {" << (entry.nameOffset == 0 ? 0 : nameOffset) << ", " << int(entry.hasSignature) << ", "
+        << int(entry.numArguments) << ", " << int(entry.returnType) << ", {";
+    for (size_t i = 0; i < kMaxSystemCallArguments; i++) out << (i > 0 ? ", " : "") << int(entry.parameters[i]);
+    out << "}, {}}, // " << number << (entry.nameOffset == 0 ? "" : ": ") << name << endl;
+    if (entry.nameOffset != 0) nameOffset += string(name).size() + 1;
+  }
+  if (table.numEntries == 0) out << "  {0, 0, 0, 0, {}, {}}" << endl;
+  out << "};" << endl;
+  out << "constexpr size_t kGeneratedNumSystemCalls = " << table.numEntries << ";" << endl << endl;
+
+  out << "constexpr char kGeneratedSystemCallNames[] =" << endl << "  \"\\0\"" << endl;
+  for (size_t number = 0; number < table.numEntries; number++) {
+    if (table.entries[number].nameOffset == 0) continue;
+    out << "  \"" << table.names + table.entries[number].nameOffset << "\\0\"" << endl;
+  }
+  out << "  ;" << endl << endl;
+}
+
+/**
+ * Function: writeErrorConstants
+ * -----------------------------
+ * Writes the supplied errno constants.  A placeholder keeps the array from being empty.
+ */
+static void writeErrorConstants(ostream& out, const map<int, string>& errorConstants) {
+  out << "constexpr staticErrorConstant kGeneratedErrorConstants[] = {" << endl;
+  for (const pair<const int, string>& p: errorConstants)
+    out << "  {" << p.first << ", \"" << p.second << "\"}," << endl;
+  if (errorConstants.empty()) out << "  {0, \"\"}" << endl;
+  out << "};" << endl;
+  out << "constexpr size_t kGeneratedNumErrorConstants = " << errorConstants.size() << ";" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    cerr << "Usage: " << argv[0] << " <output-header>" << endl;
+    return 1;
+  }
+
+  systemCallTable table;
+  try {
+    compileSystemCallTable(table, /* rebuild = */ false);
+  } catch (MissingFileException& e) {
+    cerr << e.what() << endl;
+  }
+
+  map<int, string> errorConstants;
+  try {
+    compileSystemCallErrorStrings(errorConstants);
+  } catch (MissingFileException& e) {
+    cerr << e.what() << endl;
+  }
+
+  systemCallTable empty;
+  bool anySignatures = false;
+  for (size_t number = 0; number < table.numEntries && !anySignatures; number++)
+    anySignatures = table.entries[number].hasSignature;
+  if (table.numEntries > 0 && !anySignatures)
+    cerr << argv[0] << ": No system call signatures were found, so the system call table is being left empty." << endl;
+
+  ofstream out(argv[1]);
+  out << "/**" << endl
+      << " * File: trace-generated-tables.h" << endl
+      << " * ------------------------------" << endl
+      << " * Generated by trace-generate-tables.  Do not edit." << endl
+      << " */" << endl << endl
+      << "#pragma once" << endl
+      << "#include <cstddef>" << endl
+      << "#include \"trace-static-tables.h\"" << endl << endl;
+  writeSystemCallTable(out, anySignatures ? table : empty);
+  writeErrorConstants(out, errorConstants);
+  out.close();
+  if (out.fail()) {
+    cerr << argv[0] << ": Failed to write \"" << argv[1] << "\"." << endl;
+    return 1;
+  }
+  return 0;
+}
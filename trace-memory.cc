@@ -0,0 +1,94 @@
+/**
+ * File: trace-memory.cc
+ * ---------------------
+ * Presents the implementation of the remote memory reading routines exported by trace-memory.h.
+ */
+
+#include "trace-memory.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/uio.h>    // for process_vm_readv
+#include <sys/ptrace.h>
+using namespace std;
+
+/**
+ * Constant: kPageSize
+ * -------------------
+ * The size of a virtual memory page.  Chunks are never allowed to straddle page
+ * boundaries, since the page after the one housing the end of a string may very well
+ * be unmapped, and we don't want that to spoil an otherwise successful read.
+ */
+static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+
+/**
+ * Constant: kMaxChunkSize
+ * -----------------------
+ * The size of the local buffer each chunk is read into.  Chunks are further limited by
+ * the distance to the next page boundary.
+ */
+static const size_t kMaxChunkSize = 4096;
+
+/**
+ * Function: peekChunk
+ * -------------------
+ * Fallback used when process_vm_readv fails.  Reads up to size bytes one word at a time
+ * using PTRACE_PEEKDATA, stopping early as soon as a '\0' is seen or a read fails.  Returns
+ * the number of bytes copied into buffer.
+ */
+static size_t peekChunk(pid_t pid, unsigned long addr, char buffer[], size_t size) {
+  size_t numBytesRead = 0;
+  while (numBytesRead < size) {
+    errno = 0;
+    long word = ptrace(PTRACE_PEEKDATA, pid, addr + numBytesRead);
+    if (errno != 0) break;
+    size_t count = min(sizeof(long), size - numBytesRead);
+    memcpy(buffer + numBytesRead, &word, count);
+    numBytesRead += count;
+    if (memchr(&word, '\0', count) != NULL) break;
+  }
+  
+  return numBytesRead;
+}
+
+/**
+ * Function: readChunk
+ * -------------------
+ * Reads size bytes from the tracee's address space into buffer with a single
+ * process_vm_readv call, falling back on peekChunk if that doesn't work out.  Returns
+ * the number of bytes actually read.
+ */
+static size_t readChunk(pid_t pid, unsigned long addr, char buffer[], size_t size) {
+  struct iovec local = {buffer, size};
+  struct iovec remote = {reinterpret_cast<void *>(addr), size};
+  ssize_t numBytesRead = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+  if (numBytesRead > 0) return numBytesRead;
+  return peekChunk(pid, addr, buffer, size);
+}
+
+string readRemoteString(pid_t pid, unsigned long addr, size_t maxLength, bool& truncated) {
+  string str; // start out empty
+  truncated = false;
+  char buffer[kMaxChunkSize];
+  while (true) {
+    size_t wanted = maxLength + 1 - str.size(); // one extra byte to detect that the string is too long
+    size_t size = min(min(kMaxChunkSize, kPageSize - addr % kPageSize), wanted);
+    size_t numBytesRead = readChunk(pid, addr, buffer, size);
+    if (numBytesRead == 0) return str; // unreadable memory, so just surface what we have
+    const char *end = static_cast<const char *>(memchr(buffer, '\0', numBytesRead));
+    if (end != NULL) {
+      str.append(buffer, end - buffer);
+      break;
+    }
+    str.append(buffer, numBytesRead);
+    addr += numBytesRead;
+    if (str.size() > maxLength) {
+      str.resize(maxLength);
+      truncated = true;
+      break;
+    }
+  }
+  
+  return str;
+}
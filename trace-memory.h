@@ -0,0 +1,27 @@
+/**
+ * File: trace-memory.h
+ * --------------------
+ * Exports the routines trace uses to pull data out of the address space of the
+ * process being traced.  Reads are issued a page-bounded chunk at a time via
+ * process_vm_readv, so that a long string argument costs a small number of kernel
+ * round trips instead of one PTRACE_PEEKDATA per word.
+ */
+
+#pragma once
+#include <string>
+#include <cstddef>
+#include <sys/types.h>
+
+/**
+ * Function: readRemoteString
+ * --------------------------
+ * Reads the '\0'-terminated C string residing at the supplied address in the
+ * address space of the process identified by pid, and returns it as a C++ string.
+ * At most maxLength characters are returned; if the string is longer than that,
+ * truncated is set to true (and it's set to false otherwise).  If some chunk of tracee
+ * memory can't be read via process_vm_readv (e.g. the kernel was built without
+ * CONFIG_CROSS_MEMORY_ATTACH), the word-at-a-time PTRACE_PEEKDATA approach is used
+ * as a fallback.  If the memory can't be read at all, whatever was successfully read
+ * up to that point is returned.
+ */
+std::string readRemoteString(pid_t pid, unsigned long addr, size_t maxLength, bool& truncated);
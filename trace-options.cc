@@ -6,19 +6,82 @@
 
 #include "trace-options.h"
 #include <string>
+#include <unistd.h> // for isatty
 #include "string-utils.h"
 using namespace std;
 
 static const string kSimpleFlag = "--simple";
 static const string kRebuildFlag = "--rebuild";
-size_t processCommandLineFlags(bool& simple, bool& rebuild, char *argv[]) throw (TraceException) {  
+static const string kMaxStringLengthFlag = "--max-string-length=";
+static const string kFlushLineFlag = "--flush=line";
+static const string kFlushBlockFlag = "--flush=block";
+static const string kTextFormatFlag = "--output-format=text";
+static const string kBinaryFormatFlag = "--output-format=binary";
+static const string kOutputFlag = "--output=";
+static const string kFilterFlag = "--filter=";
+static const string kSummaryFlag = "--summary";
+
+/**
+ * Function: parseNames
+ * --------------------
+ * Splits the comma-separated list beyond the '=' into its names, throwing a
+ * TraceException if the list is empty or contains an empty name.
+ */
+static vector<string> parseNames(const string& flag, const string& prefix) throw (TraceException) {
+  vector<string> names;
+  string value = flag.substr(prefix.size());
+  size_t start = 0;
+  while (true) {
+    size_t comma = value.find(',', start);
+    string name = value.substr(start, comma == string::npos ? string::npos : comma - start);
+    if (name.empty()) throw TraceException("Malformed value supplied to flag (" + flag + " )");
+    names.push_back(name);
+    if (comma == string::npos) break;
+    start = comma + 1;
+  }
+  return names;
+}
+
+/**
+ * Function: parseCount
+ * --------------------
+ * Converts the portion of the flag beyond the '=' to a positive count, throwing
+ * a TraceException if the value isn't a well-formed positive integer.
+ */
+static size_t parseCount(const string& flag, const string& prefix) throw (TraceException) {
+  string value = flag.substr(prefix.size());
+  size_t endpos = 0;
+  long long count = 0;
+  try {
+    count = stoll(value, &endpos);
+  } catch (const exception& e) {
+    endpos = 0;
+  }
+  if (value.empty() || endpos != value.size() || count <= 0)
+    throw TraceException("Malformed value supplied to flag (" + flag + " )");
+  return count;
+}
+
+size_t processCommandLineFlags(traceOptions& options, char *argv[]) throw (TraceException) {
   size_t numFlags = 0;
+  bool flushSpecified = false;
   for (int i = 1; argv[i] != NULL && startsWith(argv[i], "--"); i++) {
-    if (argv[i] == kSimpleFlag) simple = true;
-    else if (argv[i] == kRebuildFlag) rebuild = true;
+    if (argv[i] == kSimpleFlag) options.simple = true;
+    else if (argv[i] == kRebuildFlag) options.rebuild = true;
+    else if (startsWith(argv[i], kMaxStringLengthFlag)) options.maxStringLength = parseCount(argv[i], kMaxStringLengthFlag);
+    else if (argv[i] == kFlushLineFlag) { options.flush = kFlushLine; flushSpecified = true; }
+    else if (argv[i] == kFlushBlockFlag) { options.flush = kFlushBlock; flushSpecified = true; }
+    else if (argv[i] == kTextFormatFlag) options.binary = false;
+    else if (argv[i] == kBinaryFormatFlag) options.binary = true;
+    else if (startsWith(argv[i], kOutputFlag) && argv[i] != kOutputFlag) options.outputFile = string(argv[i]).substr(kOutputFlag.size());
+    else if (argv[i] == kSummaryFlag) options.summary = true;
+    else if (startsWith(argv[i], kFilterFlag)) options.filter = parseNames(argv[i], kFilterFlag);
     else throw TraceException(string(argv[0]) + ": Unrecognized flag (" + argv[i] + " )");
     numFlags++;
   }
-  
+
+  if (options.binary && options.outputFile.empty() && isatty(STDOUT_FILENO))
+    throw TraceException(string(argv[0]) + ": Binary output needs to be redirected via --output or a pipe");
+  if (!flushSpecified) options.flush = (options.outputFile.empty() && isatty(STDOUT_FILENO)) ? kFlushLine : kFlushBlock;
   return numFlags;
 }
@@ -4,15 +4,58 @@
  * Exports a single function that knows how to process the command line invoking
  * trace.  The command line typically looks like the invocation of another executable, e.g.
  * something like "find /usr/include/ -name *.h -print" preceded by "trace", e.g. 
- * "trace find /usr/include/ -name *.h -print".  However, trace itself can be fed one or two
- * flags, --simple and/or --rebuild.  The first one coaches trace to output a very simplified
- * version of trace, whereas the second one instructs trace to rebuild all of the prototypes
- * from scratch instead of relying on a cached file.
+ * "trace find /usr/include/ -name *.h -print".  However, trace itself can be fed a handful of
+ * flags ahead of the command being traced:
+ *
+ *    --simple                  outputs a very simplified version of trace
+ *    --rebuild                 rebuilds all of the prototypes from scratch instead of relying on the tables compiled into trace
+ *    --max-string-length=<n>   caps the number of characters printed for any one string argument
+ *    --flush=line|block        flushes output after every line, or only when a large buffer fills
+ *                              up or goes stale (the default is line when output goes to a terminal,
+ *                              and block otherwise)
+ *    --output-format=text|binary   prints human-readable text (the default), or records fixed-size binary
+ *                              records that trace-decode can render later on
+ *    --output=<file>           publishes output to the named file (or named pipe) instead of stdout
+ *    --filter=<name>,<name>,...   traces only the named system calls; all others run without ever
+ *                              stopping the tracee
+ *    --summary                 prints per-system-call counts, errors, and latencies once the traced
+ *                              program exits, instead of a line per system call
  *
  * If the command line is malformed (e.g. bogus flags, etc), then a TraceException is thrown.
  */
 
 #pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
 #include "trace-exception.h"
+#include "trace-output.h"
+
+/**
+ * Constant: kDefaultMaxStringLength
+ * ---------------------------------
+ * The number of characters trace is willing to pull out of the tracee for a single
+ * string argument when --max-string-length isn't supplied.  It's large enough for any
+ * path name, but small enough that one giant buffer can't stall the trace loop.
+ */
+static const size_t kDefaultMaxStringLength = 4096;
+
+/**
+ * Type: traceOptions
+ * ------------------
+ * Bundles all of the settings that can be configured from the command line.
+ */
+struct traceOptions {
+  traceOptions() : simple(false), rebuild(false), maxStringLength(kDefaultMaxStringLength),
+                   flush(kFlushLine), binary(false), summary(false) {}
+  bool simple;
+  bool rebuild;
+  size_t maxStringLength;
+  flushPolicy flush;
+  bool binary;
+  std::string outputFile;
+  std::vector<std::string> filter;
+  bool summary;
+};
 
-size_t processCommandLineFlags(bool& simple, bool& rebuild, char *argv[]) throw (TraceException);
+size_t processCommandLineFlags(traceOptions& options, char *argv[]) throw (TraceException);
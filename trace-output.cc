@@ -0,0 +1,118 @@
+/**
+ * File: trace-output.cc
+ * ---------------------
+ * Presents the implementation of the TraceOutput class.
+ */
+
+#include "trace-output.h"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * Constants: kBufferSize, kFlushThreshold, kFlushIntervalNanoseconds
+ * ------------------------------------------------------------------
+ * kBufferSize is the capacity of the output buffer.  Once kFlushThreshold bytes have
+ * accumulated the buffer is flushed, which leaves plenty of headroom for the next line.
+ * kFlushIntervalNanoseconds caps how stale buffered output can get under kFlushBlock.
+ */
+static const size_t kBufferSize = 1 << 17;
+static const size_t kFlushThreshold = kBufferSize - (1 << 12);
+static const long long kFlushIntervalNanoseconds = 100 * 1000 * 1000LL;
+
+TraceOutput::TraceOutput(int fd, flushPolicy policy) : fd(fd), policy(policy), buffer(new char[kBufferSize]), length(0) {
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &lastFlush);
+}
+
+TraceOutput::~TraceOutput() {
+  flush();
+  delete[] buffer;
+}
+
+TraceOutput& TraceOutput::putBytes(const void *bytes, size_t size) {
+  const char *data = static_cast<const char *>(bytes);
+  while (size > 0) {
+    if (length == kBufferSize) flush();
+    size_t count = min(size, kBufferSize - length);
+    memcpy(buffer + length, data, count);
+    length += count;
+    data += count;
+    size -= count;
+  }
+  return *this;
+}
+
+TraceOutput& TraceOutput::put(char ch) {
+  if (length == kBufferSize) flush();
+  buffer[length++] = ch;
+  return *this;
+}
+
+TraceOutput& TraceOutput::put(const char *str) {
+  return putBytes(str, strlen(str));
+}
+
+TraceOutput& TraceOutput::put(const string& str) {
+  return putBytes(str.data(), str.size());
+}
+
+TraceOutput& TraceOutput::putDecimal(long long value) {
+  char digits[24];
+  size_t pos = sizeof(digits);
+  unsigned long long magnitude = value < 0 ? -(unsigned long long) value : value;
+  do {
+    digits[--pos] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0) digits[--pos] = '-';
+  return putBytes(digits + pos, sizeof(digits) - pos);
+}
+
+TraceOutput& TraceOutput::putHex(unsigned long long value) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  char digits[16];
+  size_t pos = sizeof(digits);
+  do {
+    digits[--pos] = kHexDigits[value & 0xf];
+    value >>= 4;
+  } while (value > 0);
+  return putBytes(digits + pos, sizeof(digits) - pos);
+}
+
+long long TraceOutput::nanosecondsSinceFlush() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+  return (now.tv_sec - lastFlush.tv_sec) * 1000000000LL + (now.tv_nsec - lastFlush.tv_nsec);
+}
+
+bool TraceOutput::flushIntervalElapsed() {
+  return nanosecondsSinceFlush() >= kFlushIntervalNanoseconds;
+}
+
+int TraceOutput::millisecondsUntilFlushDue() {
+  if (length == 0) return -1;
+  long long remaining = kFlushIntervalNanoseconds - nanosecondsSinceFlush();
+  return remaining <= 0 ? 0 : (remaining + 999999) / 1000000;
+}
+
+void TraceOutput::endLine() {
+  put('\n');
+  endRecord();
+}
+
+void TraceOutput::endRecord() {
+  if (policy == kFlushLine || length >= kFlushThreshold || flushIntervalElapsed()) flush();
+}
+
+void TraceOutput::flush() {
+  size_t numBytesWritten = 0;
+  while (numBytesWritten < length) {
+    ssize_t count = write(fd, buffer + numBytesWritten, length - numBytesWritten);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) break; // nowhere to publish the output, so drop it
+    numBytesWritten += count;
+  }
+  length = 0;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &lastFlush);
+}
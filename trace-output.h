@@ -0,0 +1,98 @@
+/**
+ * File: trace-output.h
+ * --------------------
+ * Exports the TraceOutput class, which is the sink that all of trace's per-system-call
+ * output flows through.  Text is accumulated in a large, reusable buffer (integers and
+ * hex values are formatted by hand, so nothing is allocated along the way) and the buffer
+ * is handed to write(2) only when one of the following is true:
+ *
+ *    + the flush policy is kFlushLine and a line has just been completed,
+ *    + the buffer is close to full, or
+ *    + a line has been completed and enough time has passed since the last flush, or
+ *    + trace is waiting on its tracees and enough time has passed since the last flush
+ *      (see millisecondsUntilFlushDue), so that output isn't held back while they're quiet.
+ */
+
+#pragma once
+#include <string>
+#include <cstddef>
+#include <ctime>
+
+/**
+ * Type: flushPolicy
+ * -----------------
+ * kFlushLine flushes after every line, which is what interactive users expect.
+ * kFlushBlock only flushes when the buffer fills up or the time threshold is crossed.
+ */
+enum flushPolicy {
+  kFlushLine,
+  kFlushBlock
+};
+
+class TraceOutput {
+ public:
+  /**
+   * Constructor: TraceOutput
+   * ------------------------
+   * Configures a sink that publishes to the supplied descriptor using the supplied policy.
+   */
+  TraceOutput(int fd, flushPolicy policy);
+  ~TraceOutput();
+
+  /**
+   * Methods: put, putDecimal, putHex
+   * --------------------------------
+   * Append a character, C string, C++ string, signed decimal integer, or lowercase hex
+   * integer (without any "0x" prefix) to the buffer.
+   */
+  TraceOutput& put(char ch);
+  TraceOutput& put(const char *str);
+  TraceOutput& put(const std::string& str);
+  TraceOutput& putDecimal(long long value);
+  TraceOutput& putHex(unsigned long long value);
+
+  /**
+   * Method: putBytes
+   * ----------------
+   * Appends the supplied bytes verbatim, which is how binary records are published.
+   */
+  TraceOutput& putBytes(const void *data, size_t size);
+
+  /**
+   * Methods: endLine, endRecord
+   * ---------------------------
+   * endLine appends a newline, and then flushes if the policy or thresholds call for it.
+   * endRecord does the same thing without the newline, for binary output.
+   */
+  void endLine();
+  void endRecord();
+
+  /**
+   * Method: flush
+   * -------------
+   * Pushes everything in the buffer out to the descriptor.
+   */
+  void flush();
+
+  /**
+   * Method: millisecondsUntilFlushDue
+   * ---------------------------------
+   * Returns -1 if the buffer is empty, and otherwise the number of milliseconds until the
+   * flush interval will have passed since the last flush (or 0 if it already has), so that
+   * a caller about to block can wake up in time to flush.
+   */
+  int millisecondsUntilFlushDue();
+
+ private:
+  long long nanosecondsSinceFlush();
+  bool flushIntervalElapsed();
+
+  int fd;
+  flushPolicy policy;
+  char *buffer;
+  size_t length;
+  struct timespec lastFlush;
+
+  TraceOutput(const TraceOutput& other) = delete;
+  TraceOutput& operator=(const TraceOutput& rhs) = delete;
+};
@@ -0,0 +1,98 @@
+/**
+ * File: trace-record.cc
+ * ---------------------
+ * Presents the implementation of the binary trace record reading and writing routines.
+ */
+
+#include "trace-record.h"
+#include <cstring>
+#include "trace-exception.h"
+using namespace std;
+
+void writeTraceFileHeader(TraceOutput& out) {
+  traceFileHeader header;
+  memcpy(header.magic, kTraceFileMagic, sizeof(header.magic));
+  header.version = kTraceFileVersion;
+  header.recordSize = sizeof(traceRecord);
+  out.putBytes(&header, sizeof(header)).endRecord();
+}
+
+void writeTraceEvent(TraceOutput& out, const traceEvent& event) {
+  traceRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = kSystemCallRecord;
+  record.pid = event.pid;
+  record.timestamp = event.timestamp;
+  record.number = event.number;
+  record.flags = (event.returned ? kRecordReturned : 0) | (event.concurrent ? kRecordConcurrent : 0);
+  record.retval = event.retval;
+  for (size_t i = 0; i < kMaxSystemCallArguments; i++) {
+    record.args[i] = event.args[i];
+    if (event.captured[i] == kNotCaptured) continue;
+    record.numStrings++;
+    record.payloadLength += sizeof(traceStringHeader) + event.strings[i].size();
+  }
+
+  out.putBytes(&record, sizeof(record));
+  for (size_t i = 0; i < kMaxSystemCallArguments; i++) {
+    if (event.captured[i] == kNotCaptured) continue;
+    traceStringHeader header = {uint8_t(i), uint8_t(event.captured[i] == kTruncated), 0, uint32_t(event.strings[i].size())};
+    out.putBytes(&header, sizeof(header)).put(event.strings[i]);
+  }
+  out.endRecord();
+}
+
+void writeTraceExit(TraceOutput& out, pid_t pid, uint64_t timestamp, int status) {
+  traceRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = kExitRecord;
+  record.pid = pid;
+  record.timestamp = timestamp;
+  record.retval = status;
+  out.putBytes(&record, sizeof(record)).endRecord();
+}
+
+uint32_t readTraceFileHeader(istream& in) {
+  traceFileHeader header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (in.fail() || memcmp(header.magic, kTraceFileMagic, sizeof(header.magic)) != 0)
+    throw TraceException("Input isn't a binary trace file.");
+  if (header.version < kOldestTraceFileVersion || header.version > kTraceFileVersion ||
+      header.recordSize != sizeof(traceRecord))
+    throw TraceException("Binary trace file uses an unsupported format version.");
+  return header.version;
+}
+
+bool readTraceRecord(istream& in, uint32_t version, traceRecordType& type, traceEvent& event) {
+  traceRecord record;
+  in.read(reinterpret_cast<char *>(&record), sizeof(record));
+  if (in.gcount() == 0) return false;
+  if (in.fail()) throw TraceException("Binary trace file ends in the middle of a record.");
+
+  type = traceRecordType(record.type);
+  event.timestamp = record.timestamp;
+  event.pid = record.pid;
+  event.number = record.number;
+  event.returned = (record.flags & kRecordReturned) != 0;
+  event.concurrent = (record.flags & kRecordConcurrent) != 0;
+  event.retval = record.retval;
+  if (type == kExitRecord && version == 1) event.retval = (record.retval & 0xff) << 8; // as if by exit(code)
+  for (size_t i = 0; i < kMaxSystemCallArguments; i++) {
+    event.args[i] = record.args[i];
+    event.captured[i] = kNotCaptured;
+  }
+
+  for (size_t s = 0; s < record.numStrings; s++) {
+    traceStringHeader header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (in.fail() || header.index >= kMaxSystemCallArguments)
+      throw TraceException("Binary trace file contains a malformed string payload.");
+    string& str = event.strings[header.index];
+    str.resize(header.length);
+    if (header.length > 0) in.read(&str[0], header.length);
+    if (in.fail()) throw TraceException("Binary trace file ends in the middle of a record.");
+    event.captured[header.index] = header.truncated ? kTruncated : kCaptured;
+  }
+  
+  return true;
+}
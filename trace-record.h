@@ -0,0 +1,139 @@
+/**
+ * File: trace-record.h
+ * --------------------
+ * Defines the traceEvent type, which captures everything trace knows about a single
+ * system call, and the binary file format used by trace --output-format=binary to
+ * record those events so that they can be rendered later on by trace-decode.
+ *
+ * A binary trace file is a traceFileHeader followed by any number of records.  Each
+ * record is a fixed-size traceRecord, followed by payloadLength bytes of captured string
+ * arguments.  Each captured string is a traceStringHeader followed by length bytes of
+ * string data (with no '\0').  All fields are stored in the byte order of the machine
+ * that recorded them.
+ */
+
+#pragma once
+#include <string>
+#include <istream>
+#include <stdint.h>
+#include <sys/types.h>
+#include "trace-system-calls.h"
+#include "trace-output.h"
+
+/**
+ * Type: capturedString
+ * --------------------
+ * Identifies whether the string addressed by some argument was pulled out of the
+ * tracee, and if so, whether it was truncated.
+ */
+enum capturedString {
+  kNotCaptured,
+  kCaptured,
+  kTruncated
+};
+
+/**
+ * Type: traceEvent
+ * ----------------
+ * Everything known about one system call made by one traced process.
+ *
+ *  timestamp: nanoseconds since the epoch, as of the entry stop
+ *  pid: the id of the thread that made the system call
+ *  number: the system call number
+ *  args: the raw values of all six argument registers
+ *  returned: true if and only if the exit stop was observed (exit_group never returns)
+ *  retval: the raw return value (meaningful only if returned is true)
+ *  concurrent: true if other threads were being traced at the time, so that output
+ *              should identify the thread
+ *  captured, strings: the string arguments pulled out of the tracee, by argument index
+ */
+struct traceEvent {
+  uint64_t timestamp;
+  pid_t pid;
+  int number;
+  unsigned long args[kMaxSystemCallArguments];
+  bool returned;
+  long retval;
+  bool concurrent;
+  capturedString captured[kMaxSystemCallArguments];
+  std::string strings[kMaxSystemCallArguments];
+};
+
+/**
+ * Constants: kTraceFileMagic, kTraceFileVersion
+ * ---------------------------------------------
+ * Identify binary trace files and the version of the format they use.  Version 1 files
+ * carried the exit code of the traced process in kExitRecord records rather than its raw
+ * waitpid status; readTraceRecord translates them.
+ */
+static const char kTraceFileMagic[8] = {'T', 'R', 'A', 'C', 'E', 'R', 'E', 'C'};
+static const uint32_t kTraceFileVersion = 2;
+static const uint32_t kOldestTraceFileVersion = 1;
+
+struct traceFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+};
+
+/**
+ * Type: traceRecordType
+ * ---------------------
+ * kSystemCallRecord records carry a traceEvent.  kExitRecord records mark the
+ * termination of the traced process, and carry its raw waitpid status in retval.
+ */
+enum traceRecordType {
+  kSystemCallRecord = 1,
+  kExitRecord = 2
+};
+
+static const uint16_t kRecordReturned = 0x1;
+static const uint16_t kRecordConcurrent = 0x2;
+
+struct traceRecord {
+  uint32_t type;
+  int32_t pid;
+  uint64_t timestamp;
+  int32_t number;
+  uint16_t flags;
+  uint16_t numStrings;
+  uint64_t args[kMaxSystemCallArguments];
+  int64_t retval;
+  uint32_t payloadLength;
+  uint32_t reserved;
+};
+
+struct traceStringHeader {
+  uint8_t index;
+  uint8_t truncated;
+  uint16_t reserved;
+  uint32_t length;
+};
+
+/**
+ * Functions: writeTraceFileHeader, writeTraceEvent, writeTraceExit
+ * ----------------------------------------------------------------
+ * Publish the file header, a system call record, or a process exit record to the supplied sink.
+ */
+void writeTraceFileHeader(TraceOutput& out);
+void writeTraceEvent(TraceOutput& out, const traceEvent& event);
+void writeTraceExit(TraceOutput& out, pid_t pid, uint64_t timestamp, int status);
+
+/**
+ * Function: readTraceFileHeader
+ * -----------------------------
+ * Reads and validates the file header, and returns the format version it names.  Throws a
+ * TraceException if the stream doesn't begin with a header for a format version we understand.
+ */
+uint32_t readTraceFileHeader(std::istream& in);
+
+/**
+ * Function: readTraceRecord
+ * -------------------------
+ * Reads the next record from the supplied stream, which uses the supplied format version (as
+ * returned by readTraceFileHeader).  Returns false at end of file.  Otherwise, type is set to
+ * the type of the record, and event is populated with the record's data (for kExitRecord records,
+ * only timestamp, pid, and retval are meaningful, and retval is always a raw waitpid status).
+ * A TraceException is thrown if the stream ends in the middle of a record.
+ */
+bool readTraceRecord(std::istream& in, uint32_t version, traceRecordType& type, traceEvent& event);
@@ -0,0 +1,76 @@
+/**
+ * File: trace-signatures-benchmark.cc
+ * -----------------------------------
+ * Runs both SYSCALL_DEFINE scanners exported by the trace-system-calls module (the hand-written
+ * lexer and the original std::regex-based parser) over every file in the Linux kernel source tree,
+ * reports how long each one takes, and confirms that they extract identical signatures.  The program
+ * exits with status 0 if and only if the two scanners agree.
+ */
+
+#include "trace-system-calls.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+/**
+ * Function: timeScanner
+ * ---------------------
+ * Runs the specified scanner over all of the supplied files, populating the supplied map, and
+ * returns the number of seconds it took.
+ */
+static double timeScanner(signatureScanner scanner, const vector<string>& sourceFileNames,
+                          const map<string, int>& systemCallNames, map<string, systemCallSignature>& systemCallSignatures) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (const string& sourceFileName: sourceFileNames)
+    collectSignaturesFromKernelSourceFile(sourceFileName, systemCallNames, systemCallSignatures, scanner);
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Function: reportDifferences
+ * ---------------------------
+ * Prints every system call whose signature differs between the two maps, and returns
+ * the number of differences.
+ */
+static size_t reportDifferences(const map<string, systemCallSignature>& lexed, const map<string, systemCallSignature>& regexed) {
+  size_t numDifferences = 0;
+  for (const pair<const string, systemCallSignature>& p: lexed) {
+    auto found = regexed.find(p.first);
+    if (found != regexed.cend() && found->second == p.second) continue;
+    cout << "  " << p.first << " differs" << (found == regexed.cend() ? " (missing from regex results)" : "") << endl;
+    numDifferences++;
+  }
+  for (const pair<const string, systemCallSignature>& p: regexed) {
+    if (lexed.find(p.first) != lexed.cend()) continue;
+    cout << "  " << p.first << " differs (missing from lexer results)" << endl;
+    numDifferences++;
+  }
+  return numDifferences;
+}
+
+int main(int argc, char *argv[]) {
+  map<int, string> systemCallNumbers;
+  map<string, int> systemCallNames;
+  map<string, systemCallSignature> systemCallSignatures;
+  compileSystemCallData(systemCallNumbers, systemCallNames, systemCallSignatures, /* rebuild = */ false);
+
+  vector<string> sourceFileNames;
+  listKernelSourceFiles(sourceFileNames);
+  cout << "Scanning " << sourceFileNames.size() << " kernel source files with each scanner." << endl;
+
+  map<string, systemCallSignature> lexed, regexed;
+  double lexerSeconds = timeScanner(kLexerScanner, sourceFileNames, systemCallNames, lexed);
+  double regexSeconds = timeScanner(kRegexScanner, sourceFileNames, systemCallNames, regexed);
+  cout << fixed << setprecision(3);
+  cout << "  lexer: " << lexerSeconds << "s, " << lexed.size() << " signatures" << endl;
+  cout << "  regex: " << regexSeconds << "s, " << regexed.size() << " signatures" << endl;
+  if (lexerSeconds > 0) cout << "  speedup: " << setprecision(1) << regexSeconds / lexerSeconds << "x" << endl;
+
+  size_t numDifferences = reportDifferences(lexed, regexed);
+  cout << (numDifferences == 0 ? "The scanners agree." : "The scanners disagree!") << endl;
+  return numDifferences == 0 ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+/**
+ * File: trace-static-tables.cc
+ * ----------------------------
+ * Provides the implementation of the routines exported by trace-static-tables.h, which
+ * do little more than hand out the arrays defined in the generated trace-generated-tables.h.
+ */
+
+#include "trace-static-tables.h"
+#include "trace-generated-tables.h"
+using namespace std;
+
+bool loadStaticSystemCallTable(systemCallTable& table) {
+  bool anySignatures = false;
+  for (size_t number = 0; number < kGeneratedNumSystemCalls && !anySignatures; number++)
+    anySignatures = kGeneratedSystemCallEntries[number].hasSignature;
+  if (!anySignatures) return false; // a table of bare names is no better than none
+  table.entries = kGeneratedSystemCallEntries;
+  table.numEntries = kGeneratedNumSystemCalls;
+  table.names = kGeneratedSystemCallNames;
+  return true;
+}
+
+bool loadStaticErrorConstants(map<int, string>& errorConstants) {
+  if (kGeneratedNumErrorConstants == 0) return false;
+  for (size_t i = 0; i < kGeneratedNumErrorConstants; i++)
+    errorConstants[kGeneratedErrorConstants[i].number] = kGeneratedErrorConstants[i].name;
+  return true;
+}
@@ -0,0 +1,40 @@
+/**
+ * File: trace-static-tables.h
+ * ---------------------------
+ * Exports the system call table and errno constants that are compiled into trace itself.
+ * The tables are generated at build time by trace-generate-tables (see the Makefile) from
+ * unistd_64.h, the asm-generic errno headers, and the signature cache, so that trace needs
+ * no file I/O, no regex matching, and no system headers at startup.
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include "trace-system-calls.h"
+
+/**
+ * Type: staticErrorConstant
+ * -------------------------
+ * Pairs an errno value (e.g. 2) with the name of its #define constant (e.g. "ENOENT").
+ */
+struct staticErrorConstant {
+  int number;
+  const char *name;
+};
+
+/**
+ * Function: loadStaticSystemCallTable
+ * -----------------------------------
+ * Points the supplied (empty) table at the system call table compiled into the executable.
+ * Returns false, leaving the table untouched, if the generated table is empty (as it is when
+ * the build machine had no unistd_64.h to generate it from) or carries no signatures at all.
+ */
+bool loadStaticSystemCallTable(systemCallTable& table);
+
+/**
+ * Function: loadStaticErrorConstants
+ * ----------------------------------
+ * Populates the supplied map with the errno constants compiled into the executable.
+ * Returns false, leaving the map untouched, if none were generated.
+ */
+bool loadStaticErrorConstants(std::map<int, std::string>& errorConstants);
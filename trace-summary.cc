@@ -0,0 +1,143 @@
+/**
+ * File: trace-summary.cc
+ * ----------------------
+ * Presents the implementation of the TraceSummary class.
+ */
+
+#include "trace-summary.h"
+#include <algorithm>
+#include <cstdio>
+using namespace std;
+
+/**
+ * Constants: kSubBucketBits, kSubBucketCount, kNumBuckets
+ * -------------------------------------------------------
+ * Define the shape of the latency histograms.  Bucket i < 2 * kSubBucketCount holds
+ * exactly the value i, and every power of two beyond that is split into kSubBucketCount
+ * sub-buckets, which is enough to cover the full range of a uint64_t.
+ */
+static const int kSubBucketBits = 4;
+static const uint64_t kSubBucketCount = 1 << kSubBucketBits;
+static const size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+/**
+ * Functions: bucketIndex, bucketValue
+ * -----------------------------------
+ * bucketIndex maps a latency to its histogram bucket, and bucketValue maps a bucket back
+ * to the smallest latency it holds.
+ */
+static size_t bucketIndex(uint64_t value) {
+  if (value < 2 * kSubBucketCount) return value;
+  int shift = (63 - __builtin_clzll(value)) - kSubBucketBits;
+  return shift * kSubBucketCount + (value >> shift);
+}
+
+static uint64_t bucketValue(size_t index) {
+  if (index < 2 * kSubBucketCount) return index;
+  int shift = index / kSubBucketCount - 1;
+  return (kSubBucketCount + index % kSubBucketCount) << shift;
+}
+
+TraceSummary::systemCallStats& TraceSummary::statsFor(int number) {
+  if (number < 0) number = 0; // never happens for real system calls
+  if (size_t(number) >= stats.size()) stats.resize(number + 1);
+  return stats[number];
+}
+
+void TraceSummary::recordSystemCall(int number, long retval, uint64_t nanoseconds) {
+  systemCallStats& s = statsFor(number);
+  s.calls++;
+  if (retval < 0 && retval >= -4095) { // the kernel reports errors as -errno
+    s.errors++;
+    s.errnoCounts[-retval]++;
+  }
+  s.totalNanoseconds += nanoseconds;
+  s.maxNanoseconds = max(s.maxNanoseconds, nanoseconds);
+  if (s.histogram.empty()) s.histogram.resize(kNumBuckets);
+  s.histogram[bucketIndex(nanoseconds)]++;
+}
+
+void TraceSummary::recordUnfinishedSystemCall(int number) {
+  systemCallStats& s = statsFor(number);
+  s.calls++;
+  s.unfinished++;
+}
+
+uint64_t TraceSummary::percentile(const systemCallStats& s, double fraction) {
+  uint64_t timed = s.calls - s.unfinished;
+  uint64_t rank = max<uint64_t>(1, uint64_t(fraction * timed + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < s.histogram.size(); i++) {
+    seen += s.histogram[i];
+    if (seen >= rank) return bucketValue(i);
+  }
+  return s.maxNanoseconds;
+}
+
+void TraceSummary::print(TraceOutput& out, const systemCallTable& systemCalls, const map<int, string>& errorConstants) const {
+  vector<int> numbers;
+  uint64_t totalNanoseconds = 0, totalCalls = 0, totalErrors = 0;
+  for (size_t number = 0; number < stats.size(); number++) {
+    if (stats[number].calls == 0) continue;
+    numbers.push_back(number);
+    totalNanoseconds += stats[number].totalNanoseconds;
+    totalCalls += stats[number].calls;
+    totalErrors += stats[number].errors;
+  }
+  sort(numbers.begin(), numbers.end(), [this](int one, int two) {
+    const systemCallStats& s1 = stats[one];
+    const systemCallStats& s2 = stats[two];
+    if (s1.totalNanoseconds != s2.totalNanoseconds) return s1.totalNanoseconds > s2.totalNanoseconds;
+    if (s1.calls != s2.calls) return s1.calls > s2.calls;
+    return one < two;
+  });
+
+  char line[256];
+  snprintf(line, sizeof(line), "%6s %11s %11s %9s %9s %s", "% time", "seconds", "usecs/call", "calls", "errors", "syscall");
+  out.put(line).endLine();
+  out.put("------ ----------- ----------- --------- --------- ----------------").endLine();
+  for (int number: numbers) {
+    const systemCallStats& s = stats[number];
+    const char *name = systemCallName(systemCalls, number);
+    uint64_t timed = s.calls - s.unfinished;
+    snprintf(line, sizeof(line), "%6.2f %11.6f %11llu %9llu %9llu %s",
+             totalNanoseconds == 0 ? 0.0 : 100.0 * s.totalNanoseconds / totalNanoseconds,
+             s.totalNanoseconds / 1e9, (unsigned long long) (timed == 0 ? 0 : s.totalNanoseconds / timed / 1000),
+             (unsigned long long) s.calls, (unsigned long long) s.errors, *name ? name : "?");
+    out.put(line);
+    if (*name == '\0') out.putDecimal(number);
+    out.endLine();
+  }
+  out.put("------ ----------- ----------- --------- --------- ----------------").endLine();
+  snprintf(line, sizeof(line), "%6.2f %11.6f %11s %9llu %9llu %s", 100.0, totalNanoseconds / 1e9, "",
+           (unsigned long long) totalCalls, (unsigned long long) totalErrors, "total");
+  out.put(line).endLine();
+
+  out.endLine();
+  out.put("Latency (usecs) and errors by system call:").endLine();
+  for (int number: numbers) {
+    const systemCallStats& s = stats[number];
+    const char *name = systemCallName(systemCalls, number);
+    out.put("  ").put(*name ? name : "?");
+    if (*name == '\0') out.putDecimal(number);
+    if (s.calls > s.unfinished) {
+      snprintf(line, sizeof(line), ": mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f",
+               s.totalNanoseconds / 1e3 / (s.calls - s.unfinished), percentile(s, 0.5) / 1e3,
+               percentile(s, 0.9) / 1e3, percentile(s, 0.99) / 1e3, s.maxNanoseconds / 1e3);
+      out.put(line);
+    } else {
+      out.put(": never returned");
+    }
+    out.endLine();
+    for (const pair<const int, uint64_t>& p: s.errnoCounts) {
+      auto found = errorConstants.find(p.first);
+      out.put("      ");
+      if (found == errorConstants.cend()) {
+        out.put("errno ").putDecimal(p.first);
+      } else {
+        out.put(found->second);
+      }
+      out.put(": ").putDecimal(p.second).endLine();
+    }
+  }
+}
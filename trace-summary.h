@@ -0,0 +1,65 @@
+/**
+ * File: trace-summary.h
+ * ---------------------
+ * Exports the TraceSummary class, which backs trace --summary.  Instead of printing a
+ * line per system call, trace feeds each completed system call to a TraceSummary, which
+ * tallies calls, errors (broken down by errno), and time spent, and which maintains a
+ * latency histogram for each system call number.  The report is printed once the traced
+ * program exits.
+ *
+ * Latency histograms are HDR-style: values below 32ns are counted exactly, and larger
+ * values land in one of 16 equally sized sub-buckets per power of two, so that any
+ * reported percentile is within about 6% of the true value.
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "trace-system-calls.h"
+#include "trace-output.h"
+
+class TraceSummary {
+ public:
+  /**
+   * Method: recordSystemCall
+   * ------------------------
+   * Tallies a completed system call, given its number, its raw return value, and the
+   * number of nanoseconds that passed between its entry and exit stops.
+   */
+  void recordSystemCall(int number, long retval, uint64_t nanoseconds);
+
+  /**
+   * Method: recordUnfinishedSystemCall
+   * ----------------------------------
+   * Tallies a system call that never returned (e.g. exit_group), which counts as a call
+   * but contributes nothing to the time or latency figures.
+   */
+  void recordUnfinishedSystemCall(int number);
+
+  /**
+   * Method: print
+   * -------------
+   * Prints the report: one row per system call that was made, sorted by total time (and
+   * then by call count), followed by the errno and latency breakdowns for each.
+   */
+  void print(TraceOutput& out, const systemCallTable& systemCalls, const std::map<int, std::string>& errorConstants) const;
+
+ private:
+  struct systemCallStats {
+    systemCallStats() : calls(0), errors(0), unfinished(0), totalNanoseconds(0), maxNanoseconds(0) {}
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t unfinished;
+    uint64_t totalNanoseconds;
+    uint64_t maxNanoseconds;
+    std::map<int, uint64_t> errnoCounts;
+    std::vector<uint32_t> histogram; // allocated the first time a latency is recorded
+  };
+
+  systemCallStats& statsFor(int number);
+  static uint64_t percentile(const systemCallStats& stats, double fraction);
+
+  std::vector<systemCallStats> stats; // indexed by system call number
+};
@@ -8,8 +8,20 @@
 #include "trace-system-calls.h"
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <regex>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <ext/stdio_filebuf.h>
 #include <sys/wait.h>
 #include "subprocess.h"
@@ -269,9 +281,9 @@ static void processSystemCallSignature(const string& macro, map<string, systemCa
  *    .* matches everything beyond the opening parenthesis
  */
 static const string kSystemCallNameAndArgumentCountPattern = "\\s*SYSCALL_DEFINE[0-6]\\s*\\(.*";
-static void processSignaturesWithinKernelSourceFile(const string& sourceFileName, 
-                                                    map<string, systemCallSignature>& systemCallSignatures, 
-                                                    const map<string, int>& systemCallNames) {
+static void scanKernelSourceFileWithRegex(const string& sourceFileName, 
+                                          map<string, systemCallSignature>& systemCallSignatures, 
+                                          const map<string, int>& systemCallNames) {
   ifstream infile(sourceFileName);
   regex re(kSystemCallNameAndArgumentCountPattern);
   while (true) {
@@ -286,62 +298,239 @@ static void processSignaturesWithinKernelSourceFile(const string& sourceFileName
 }
 
 /**
- * Function: loadSignaturesFromCache
- * ---------------------------------
+ * Function: splitMacroArguments
+ * -----------------------------
+ * Splits everything beyond the opening parenthesis of a SYSCALL_DEFINE macro on commas.  The
+ * regex-based parser requires that there be exactly 2 * numArguments commas, that no argument be
+ * empty, and that the macro end with a close parenthesis (optionally followed by whitespace)
+ * that isn't the only thing in the final argument.  This returns false unless all of that holds,
+ * so that exactly the same macros are accepted.
  */
-static const string kCacheFilename = ".trace_signatures.txt";
-static bool loadSignaturesFromCache(map<string, systemCallSignature>& systemCallSignatures) {
-  ifstream cache(kCacheFilename);
-  if (cache.fail()) return false;
+static bool splitMacroArguments(const string& macro, size_t open, int numArguments, vector<string>& arguments) {
+  size_t start = open + 1;
   while (true) {
-    string name;
-    cache >> name;
-    if (cache.fail()) break;
+    size_t comma = macro.find(',', start);
+    size_t end = comma == string::npos ? macro.size() : comma;
+    if (end == start) return false;
+    arguments.push_back(macro.substr(start, end - start));
+    if (comma == string::npos) break;
+    start = comma + 1;
+  }
+  if (arguments.size() != size_t(2 * numArguments + 1)) return false;
+
+  string& last = arguments.back();
+  size_t close = last.size();
+  while (close > 0 && isspace((unsigned char) last[close - 1])) close--;
+  return close >= 2 && last[close - 1] == ')';
+}
+
+/**
+ * Function: extractMacroName
+ * --------------------------
+ * Pulls the system call name out of the supplied SYSCALL_DEFINE macro, returning false if
+ * there isn't one.
+ */
+static bool extractMacroName(const string& macro, string& name) {
+  size_t open = macro.find('(');
+  size_t nameEnd = macro.find_first_of(",)", open + 1);
+  if (nameEnd == string::npos || nameEnd == open + 1) return false;
+  name = trim(macro.substr(open + 1, nameEnd - open - 1));
+  return true;
+}
+
+/**
+ * Function: processMacroWithLexer
+ * -------------------------------
+ * Lexer-based equivalent of processSystemCallSignature: pulls the name out of the supplied macro
+ * (which is known to be a SYSCALL_DEFINE<numArguments> macro), and if it's a system call we know
+ * about but haven't seen yet, records the normalized types of its parameters.
+ */
+static void processMacroWithLexer(const string& macro, int numArguments,
+                                  map<string, systemCallSignature>& systemCallSignatures,
+                                  const map<string, int>& systemCallNames) {
+  string name;
+  if (!extractMacroName(macro, name)) return;
+  if (systemCallNames.find(name) == systemCallNames.cend() ||
+      systemCallSignatures.find(name) != systemCallSignatures.cend()) return;
+
+  if (numArguments == 0) {
     systemCallSignatures[name];
-    string count;
-    cache >> count;
-    for (int i = 0; i < stoi(count); i++) {
-      scParamType type;
-      cache >> type;
-      systemCallSignatures[name].push_back(type);
-    }
+    return;
+  }
+
+  vector<string> arguments;
+  if (!splitMacroArguments(macro, macro.find('('), numArguments, arguments)) return;
+  systemCallSignature& parameterTypes = systemCallSignatures[name];
+  for (int i = 0; i < numArguments; i++)
+    parameterTypes.push_back(normalizeType(trim(arguments[2 * i + 1])));
+}
+
+/**
+ * Function: readEntireFile
+ * ------------------------
+ * Reads the full contents of the named file into the supplied string with as few
+ * system calls as possible.  Returns false if the file can't be read.
+ */
+static bool readEntireFile(const string& fileName, string& contents) {
+  int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return false;
   }
+
+  contents.resize(st.st_size);
+  size_t numBytesRead = 0;
+  while (numBytesRead < contents.size()) {
+    ssize_t count = read(fd, &contents[numBytesRead], contents.size() - numBytesRead);
+    if (count <= 0) break;
+    numBytesRead += count;
+  }
+  contents.resize(numBytesRead);
+  close(fd);
   return true;
 }
 
 /**
- * Function: cacheSignatures
- * -------------------------
- * Because it takes such a long time to compile the system call signature information, and because
- * it doesn't change for months at a time, we store the signature data to a file named kCacheFilename.
- */
-static void cacheSignatures(const map<string, systemCallSignature>& systemCallSignatures) {
-  ofstream cache(kCacheFilename);
-  for (const pair<const string, systemCallSignature>& p: systemCallSignatures) {
-    cache << p.first << " " << p.second.size();
-    for (scParamType type: p.second) cache << " " << type;
-    cache << endl;
+ * Function: findNextSystemCallMacro
+ * ---------------------------------
+ * Finds the next SYSCALL_DEFINE macro in the file contents between begin and end, starting at
+ * cursor (which must be the beginning or the end of a line).  memmem (which glibc vectorizes)
+ * hops from one SYSCALL_DEFINE token to the next, so the vast majority of the file is never
+ * examined a character at a time.  A token only counts if it's preceded by nothing but
+ * whitespace on its line and is followed by a digit between 0 and 6, optional whitespace, and an
+ * open parenthesis, just as kSystemCallNameAndArgumentCountPattern requires.  The macro is then
+ * ingested line by line (with the newlines dropped) until a close parenthesis has been seen,
+ * mirroring ingestEntireMacro.  On success, macroLine is set to the beginning of the line the
+ * macro starts on, and cursor to the end of the line it finishes on, which is where the next
+ * search should resume.  Returns false once there are no more macros.
+ */
+static const char kSystemCallDefineToken[] = "SYSCALL_DEFINE";
+static const size_t kSystemCallDefineTokenLength = sizeof(kSystemCallDefineToken) - 1;
+static bool findNextSystemCallMacro(const char *begin, const char *end, const char *& cursor,
+                                    string& macro, int& numArguments, const char *& macroLine) {
+  while (cursor < end) {
+    const char *token = static_cast<const char *>(memmem(cursor, end - cursor, kSystemCallDefineToken, kSystemCallDefineTokenLength));
+    if (token == NULL) return false;
+    const char *lineStart = token;
+    while (lineStart > begin && lineStart[-1] != '\n') lineStart--;
+    const char *lineEnd = static_cast<const char *>(memchr(token, '\n', end - token));
+    if (lineEnd == NULL) lineEnd = end;
+    cursor = lineEnd; // if this line doesn't pan out, no other token on it can either
+
+    const char *p = lineStart;
+    while (p < token && isspace((unsigned char) *p)) p++;
+    if (p != token) continue;
+    p = token + kSystemCallDefineTokenLength;
+    if (p == lineEnd || *p < '0' || *p > '6') continue;
+    numArguments = *p++ - '0';
+    while (p < lineEnd && isspace((unsigned char) *p)) p++;
+    if (p == lineEnd || *p != '(') continue;
+    if (memchr(p, '\r', lineEnd - p) != NULL) continue; // . doesn't match \r
+
+    macro.assign(lineStart, lineEnd);
+    while (macro.find(')') == string::npos) {
+      if (cursor == end) return false; // unterminated macro at the end of the file
+      const char *nextLine = cursor + 1;
+      cursor = static_cast<const char *>(memchr(nextLine, '\n', end - nextLine));
+      if (cursor == NULL) cursor = end;
+      macro.append(nextLine, cursor);
+    }
+    macroLine = lineStart;
+    return true;
   }
+  return false;
 }
 
 /**
- * Function: processAllKernelSourceFiles
- * -------------------------------------
- * Reads the list of kernel source files printed by the supplied subprocess and parses each one, looking for
- * SYSCALL_DEFINE[0-6] macros.  Most of the work is done by processSignaturesWithinKernelSourceFile.  The code
- * exposed in this function is pretty self-explanatory.
+ * Function: scanKernelSourceFileWithLexer
+ * ---------------------------------------
+ * Hand-written replacement for scanKernelSourceFileWithRegex that produces exactly the same
+ * signatures.  The whole file is read in at once, and findNextSystemCallMacro does the lexing.
  */
-static void processAllKernelSourceFiles(const subprocess_t& sp, map<string, systemCallSignature>& systemCallSignatures, const map<string, int>& systemCallNames) {
-  stdio_filebuf<char> processbuf(sp.ingestfd, ios::in);
-  istream instream(&processbuf); // wrap the ingest file descriptor in a C++ istream so we can more easily parse each file line by line.
+static void scanKernelSourceFileWithLexer(const string& sourceFileName,
+                                          map<string, systemCallSignature>& systemCallSignatures,
+                                          const map<string, int>& systemCallNames) {
+  string contents;
+  if (!readEntireFile(sourceFileName, contents)) return;
+  const char *begin = contents.data();
+  const char *end = begin + contents.size();
+  const char *cursor = begin;
+  const char *macroLine;
+  string macro;
+  int numArguments;
+  while (findNextSystemCallMacro(begin, end, cursor, macro, numArguments, macroLine))
+    processMacroWithLexer(macro, numArguments, systemCallSignatures, systemCallNames);
+}
+
+void collectSignaturesFromKernelSourceFile(const string& sourceFileName,
+                                           const map<string, int>& systemCallNames,
+                                           map<string, systemCallSignature>& systemCallSignatures,
+                                           signatureScanner scanner) {
+  if (scanner == kRegexScanner) {
+    scanKernelSourceFileWithRegex(sourceFileName, systemCallSignatures, systemCallNames);
+  } else {
+    scanKernelSourceFileWithLexer(sourceFileName, systemCallSignatures, systemCallNames);
+  }
+}
+
+/**
+ * Type: indexedSignatures
+ * -----------------------
+ * Maps system call names to their signatures, along with the index (within the list of kernel
+ * source files) of the file each signature was pulled from.  The indices are what allow the
+ * partial maps built up by concurrent workers to be merged so that the result is precisely
+ * what a serial pass would produce: the signature from the earliest file wins.
+ */
+typedef map<string, pair<size_t, systemCallSignature>> indexedSignatures;
+
+/**
+ * Function: parseKernelSourceFiles
+ * --------------------------------
+ * Thread routine run by each worker.  Workers claim files one at a time, in increasing
+ * index order, by advancing the shared atomic counter, and record what they find in their
+ * own partial map (which no other thread touches).  Because a worker's indices only ever increase,
+ * inserting without overwriting keeps the earliest signature the worker has seen for each name.
+ */
+static void parseKernelSourceFiles(const vector<string>& sourceFileNames, atomic<size_t>& next,
+                                   const map<string, int>& systemCallNames, indexedSignatures& partial) {
   while (true) {
-    string sourceFileName;
-    getline(instream, sourceFileName);
-    if (instream.fail()) break;
-    processSignaturesWithinKernelSourceFile(sourceFileName, systemCallSignatures, systemCallNames);
+    size_t index = next++;
+    if (index >= sourceFileNames.size()) break;
+    map<string, systemCallSignature> fileSignatures;
+    scanKernelSourceFileWithLexer(sourceFileNames[index], fileSignatures, systemCallNames);
+    for (const pair<const string, systemCallSignature>& p: fileSignatures)
+      partial.insert(make_pair(p.first, make_pair(index, p.second)));
   }
+}
 
-  waitpid(sp.pid, NULL, 0);
+/**
+ * Function: mergePartialSignatures
+ * --------------------------------
+ * Merges all of the workers' partial maps, keeping the signature pulled from the
+ * earliest file for each system call name.
+ */
+static void mergePartialSignatures(const vector<indexedSignatures>& partials, map<string, systemCallSignature>& systemCallSignatures) {
+  indexedSignatures merged;
+  for (const indexedSignatures& partial: partials) {
+    for (const pair<const string, pair<size_t, systemCallSignature>>& p: partial) {
+      auto found = merged.find(p.first);
+      if (found == merged.end() || p.second.first < found->second.first) merged[p.first] = p.second;
+    }
+  }
+
+  for (const pair<const string, pair<size_t, systemCallSignature>>& p: merged)
+    systemCallSignatures[p.first] = p.second.second;
+}
+
+/**
+ * Function: secondsSince
+ * ----------------------
+ * Returns the number of seconds that have passed since the supplied time point.
+ */
+static double secondsSince(const chrono::steady_clock::time_point& start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
 }
 
 /**
@@ -353,15 +542,406 @@ static void processAllKernelSourceFiles(const subprocess_t& sp, map<string, syst
  */
 static const string kKernelSourceCodeDirectory = "/usr/class/cs110/local/src/linux";
 static const char *const kKernelSourceFileFinderCommand[] = {"find", kKernelSourceCodeDirectory.c_str(), "-name", "*.c", "-print", NULL};
-static void collectSystemCallSignatures(map<string, systemCallSignature>& systemCallSignatures, const map<string, int>& systemCallNames, bool rebuild) {
-  if (!rebuild && loadSignaturesFromCache(systemCallSignatures)) return;
+
+void listKernelSourceFiles(vector<string>& sourceFileNames) {
   subprocess_t sp = subprocess(const_cast<char **>(kKernelSourceFileFinderCommand), 
                                /* supplyChildInput = */ false, 
                                /* ingestChildOutput = */ true);
+  stdio_filebuf<char> processbuf(sp.ingestfd, ios::in);
+  istream instream(&processbuf); // wrap the ingest file descriptor in a C++ istream so we can more easily parse each file line by line.
+  while (true) {
+    string sourceFileName;
+    getline(instream, sourceFileName);
+    if (instream.fail()) break;
+    sourceFileNames.push_back(sourceFileName);
+  }
+
+  waitpid(sp.pid, NULL, 0);
+}
+
+/**
+ * Function: processAllKernelSourceFiles
+ * -------------------------------------
+ * Lists all of the kernel source files, and then parses all of them using a pool of worker threads
+ * (one per CPU), looking for SYSCALL_DEFINE[0-6] macros.  Most of the work is done by
+ * scanKernelSourceFileWithLexer.  The time spent in each phase is reported as we go.
+ */
+static void processAllKernelSourceFiles(map<string, systemCallSignature>& systemCallSignatures, const map<string, int>& systemCallNames) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector<string> sourceFileNames;
+  listKernelSourceFiles(sourceFileNames);
+  ios_base::fmtflags flags = cout.flags(); // restored below, so the rest of the program's output is unaffected
+  streamsize precision = cout.precision();
+  cout << fixed << setprecision(3);
+  cout << "  found " << sourceFileNames.size() << " source files in " << secondsSince(start) << "s" << endl;
+
+  start = chrono::steady_clock::now();
+  size_t numWorkers = max(1U, thread::hardware_concurrency());
+  vector<indexedSignatures> partials(numWorkers);
+  vector<thread> workers;
+  atomic<size_t> next(0);
+  for (size_t i = 0; i < numWorkers; i++)
+    workers.push_back(thread(parseKernelSourceFiles, cref(sourceFileNames), ref(next), cref(systemCallNames), ref(partials[i])));
+  for (thread& worker: workers) worker.join();
+  double parseSeconds = secondsSince(start);
+  cout << "  parsed them in " << parseSeconds << "s using " << numWorkers << " threads ("
+       << size_t(sourceFileNames.size() / max(parseSeconds, 1e-6)) << " files/sec)" << endl;
+
+  start = chrono::steady_clock::now();
+  mergePartialSignatures(partials, systemCallSignatures);
+  cout << "  merged the signatures in " << secondsSince(start) << "s" << endl;
+  cout.flags(flags);
+  cout.precision(precision);
+}
+
+/**
+ * Constant: kPointerReturningSystemCalls
+ * --------------------------------------
+ * Names the system calls whose return values are addresses and should be printed in hex.
+ */
+static const string kPointerReturningSystemCalls[] = {"brk", "sbrk", "mmap"};
+
+/**
+ * Function: fillSignature
+ * -----------------------
+ * Inlines the signature of the named system call into the supplied entry, provided
+ * systemCallSignatures has one.
+ */
+static void fillSignature(systemCallEntry& entry, const string& name,
+                          const map<string, systemCallSignature>& systemCallSignatures) {
+  auto found = systemCallSignatures.find(name);
+  if (found == systemCallSignatures.cend()) return;
+  const systemCallSignature& signature = found->second;
+  entry.hasSignature = 1;
+  entry.numArguments = min(signature.size(), kMaxSystemCallArguments);
+  for (size_t i = 0; i < entry.numArguments; i++) entry.parameters[i] = signature[i];
+}
+
+/**
+ * Function: buildSystemCallTable
+ * ------------------------------
+ * Flattens the supplied maps into the table's own storage, interning all of the names
+ * and inlining each signature, and points the table at that storage.
+ */
+static void buildSystemCallTable(const map<int, string>& systemCallNumbers,
+                                 const map<string, systemCallSignature>& systemCallSignatures,
+                                 systemCallTable& table) {
+  int maxNumber = systemCallNumbers.empty() ? -1 : systemCallNumbers.crbegin()->first;
+  systemCallEntry unknown = {0, 0, 0, SYSCALL_INTEGER, {}, {}};
+  table.entryStorage.assign(maxNumber + 1, unknown);
+  table.nameStorage.push_back('\0'); // offset 0 is the empty name shared by all unknown numbers
+  for (const pair<const int, string>& p: systemCallNumbers) {
+    if (p.first < 0) continue;
+    systemCallEntry& entry = table.entryStorage[p.first];
+    entry.nameOffset = table.nameStorage.size();
+    table.nameStorage.insert(table.nameStorage.end(), p.second.begin(), p.second.end());
+    table.nameStorage.push_back('\0');
+    for (const string& name: kPointerReturningSystemCalls)
+      if (p.second == name) entry.returnType = SYSCALL_POINTER;
+    fillSignature(entry, p.second, systemCallSignatures);
+  }
+
+  table.entries = table.entryStorage.data();
+  table.numEntries = table.entryStorage.size();
+  table.names = table.nameStorage.data();
+}
+
+/**
+ * Type: systemCallCacheHeader
+ * ---------------------------
+ * Leads off the binary signature cache, which is laid out so it can be mapped into memory and
+ * used in place: the header is followed immediately by numEntries systemCallEntry records and
+ * then by the namesLength bytes of '\0'-terminated names the entries' nameOffsets index into.
+ *
+ *  magic: kCacheMagic, identifying the file as a signature cache
+ *  version: kCacheVersion, which is bumped whenever the layout of the file or of systemCallEntry changes
+ *  entrySize: sizeof(systemCallEntry) when the cache was written, as a sanity check
+ *  sourceHash: the hash of kUniversalStandardAbsoluteFilename the table was built from, so that a cache
+ *              built against a different set of system calls is detected and rebuilt
+ */
+struct systemCallCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t entrySize;
+  uint64_t sourceHash;
+  uint32_t numEntries;
+  uint32_t namesLength;
+};
+
+static const string kCacheFilename = ".trace_signatures.bin";
+static const char kCacheMagic[8] = {'T', 'R', 'A', 'C', 'E', 'S', 'I', 'G'};
+static const uint32_t kCacheVersion = 1;
+
+/**
+ * Function: hashSystemCallSources
+ * -------------------------------
+ * Computes the 64-bit FNV-1a hash of kUniversalStandardAbsoluteFilename, returning false
+ * if it can't be read.
+ */
+static bool hashSystemCallSources(uint64_t& hash) {
+  string contents;
+  if (!readEntireFile(kUniversalStandardAbsoluteFilename, contents)) return false;
+  hash = 14695981039346656037ULL;
+  for (char ch: contents) {
+    hash ^= (unsigned char) ch;
+    hash *= 1099511628211ULL;
+  }
+  return true;
+}
+
+/**
+ * Function: isValidCache
+ * ----------------------
+ * Confirms that the length byte mapping is a complete, current signature cache whose
+ * entries all reference names within the cache, and that at least one entry has a signature
+ * (a cache without any could only have come from a scan that found nothing, and shouldn't keep
+ * later runs from trying the sources again).  If the system header can't be read, there's
+ * nothing to check the cache's hash against (and nothing to rebuild it from), so it's trusted.
+ */
+static bool isValidCache(const char *mapping, size_t length) {
+  if (length < sizeof(systemCallCacheHeader)) return false;
+  const systemCallCacheHeader *header = reinterpret_cast<const systemCallCacheHeader *>(mapping);
+  if (memcmp(header->magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header->version != kCacheVersion ||
+      header->entrySize != sizeof(systemCallEntry)) return false;
+  if (length != sizeof(systemCallCacheHeader) + size_t(header->numEntries) * sizeof(systemCallEntry) + header->namesLength)
+    return false;
+  const char *names = mapping + length - header->namesLength;
+  if (header->namesLength == 0 || names[header->namesLength - 1] != '\0') return false;
+  const systemCallEntry *entries = reinterpret_cast<const systemCallEntry *>(header + 1);
+  bool anySignatures = false;
+  for (size_t i = 0; i < header->numEntries; i++) {
+    if (entries[i].nameOffset >= header->namesLength || entries[i].numArguments > kMaxSystemCallArguments) return false;
+    if (entries[i].hasSignature) anySignatures = true;
+  }
+  if (!anySignatures) return false;
+
+  uint64_t hash;
+  return !hashSystemCallSources(hash) || hash == header->sourceHash;
+}
+
+/**
+ * Function: mapSystemCallCache
+ * ----------------------------
+ * Maps kCacheFilename into memory and, provided it's valid, points the supplied table
+ * directly at the entries and names within the mapping.  Returns false (leaving the
+ * table untouched) if the cache is missing, malformed, or stale.
+ */
+static bool mapSystemCallCache(systemCallTable& table) {
+  int fd = open(kCacheFilename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+  if (!isValidCache(static_cast<const char *>(mapping), st.st_size)) {
+    munmap(mapping, st.st_size);
+    return false;
+  }
+
+  const systemCallCacheHeader *header = static_cast<const systemCallCacheHeader *>(mapping);
+  table.mapping = mapping;
+  table.mappingLength = st.st_size;
+  table.entries = reinterpret_cast<const systemCallEntry *>(header + 1);
+  table.numEntries = header->numEntries;
+  table.names = reinterpret_cast<const char *>(table.entries + table.numEntries);
+  return true;
+}
+
+/**
+ * Function: cacheSystemCallTable
+ * ------------------------------
+ * Because it takes such a long time to compile the system call signature information, and because
+ * it doesn't change for months at a time, we store the table to a file named kCacheFilename.  The
+ * cache is written to a temporary file that's then renamed into place, so that a concurrently
+ * running trace never maps a partially written cache.
+ */
+static void cacheSystemCallTable(const systemCallTable& table) {
+  systemCallCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.entrySize = sizeof(systemCallEntry);
+  if (!hashSystemCallSources(header.sourceHash)) header.sourceHash = 0;
+  header.numEntries = table.numEntries;
+  header.namesLength = table.nameStorage.size();
+
+  string temporaryFilename = kCacheFilename + "." + to_string(getpid());
+  ofstream cache(temporaryFilename, ios::binary | ios::trunc);
+  cache.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  cache.write(reinterpret_cast<const char *>(table.entries), table.numEntries * sizeof(systemCallEntry));
+  cache.write(table.names, header.namesLength);
+  cache.close();
+  if (cache.fail() || rename(temporaryFilename.c_str(), kCacheFilename.c_str()) == -1)
+    unlink(temporaryFilename.c_str());
+}
+
+/**
+ * Type: systemCallIndex
+ * ---------------------
+ * Maps system call names to the locations of the SYSCALL_DEFINE macros naming them, each
+ * a pair of the index (within the list of kernel source files) of the file holding the macro
+ * and the offset of the line it starts on.  Each name's locations are kept in the order an
+ * eager parse would come across them.  There's usually just one, but if the first macro for a
+ * name can't be parsed, the parse moves on to the next, so every one of them is recorded.
+ */
+typedef map<string, vector<pair<size_t, size_t>>> systemCallIndex;
+
+/**
+ * Function: indexKernelSourceFiles
+ * --------------------------------
+ * Thread routine run by each of the workers building an index.  Just like parseKernelSourceFiles,
+ * workers claim files one at a time by advancing the shared atomic counter, and record what they
+ * find in their own partial index.  Only the names of the macros are pulled out; their
+ * parameters are left for resolveFromIndex to parse.
+ */
+static void indexKernelSourceFiles(const vector<string>& sourceFileNames, atomic<size_t>& next,
+                                   const map<string, int>& systemCallNames, systemCallIndex& partial) {
+  while (true) {
+    size_t index = next++;
+    if (index >= sourceFileNames.size()) break;
+    string contents;
+    if (!readEntireFile(sourceFileNames[index], contents)) continue;
+    const char *begin = contents.data();
+    const char *cursor = begin;
+    const char *macroLine;
+    string macro, name;
+    int numArguments;
+    while (findNextSystemCallMacro(begin, begin + contents.size(), cursor, macro, numArguments, macroLine)) {
+      if (extractMacroName(macro, name) && systemCallNames.find(name) != systemCallNames.cend())
+        partial[name].push_back(make_pair(index, size_t(macroLine - begin)));
+    }
+  }
+}
+
+/**
+ * Function: buildSystemCallIndex
+ * ------------------------------
+ * Indexes all of the supplied source files using a pool of worker threads (one per CPU), and
+ * merges the workers' partial indices, sorting each name's locations back into file order.
+ */
+static void buildSystemCallIndex(const vector<string>& sourceFileNames, const map<string, int>& systemCallNames,
+                                 systemCallIndex& index) {
+  size_t numWorkers = max(1U, thread::hardware_concurrency());
+  vector<systemCallIndex> partials(numWorkers);
+  vector<thread> workers;
+  atomic<size_t> next(0);
+  for (size_t i = 0; i < numWorkers; i++)
+    workers.push_back(thread(indexKernelSourceFiles, cref(sourceFileNames), ref(next), cref(systemCallNames), ref(partials[i])));
+  for (thread& worker: workers) worker.join();
+
+  for (const systemCallIndex& partial: partials) {
+    for (const pair<const string, vector<pair<size_t, size_t>>>& p: partial) {
+      vector<pair<size_t, size_t>>& locations = index[p.first];
+      locations.insert(locations.end(), p.second.begin(), p.second.end());
+    }
+  }
+  for (pair<const string, vector<pair<size_t, size_t>>>& p: index) sort(p.second.begin(), p.second.end());
+}
+
+/**
+ * Type: systemCallResolver
+ * ------------------------
+ * Tracks the progress of a lazy parse of the kernel sources.  The source files are listed
+ * and indexed only once the first signature is needed, and from then on, each signature is
+ * parsed from just the macro(s) the index points to, so that it's always pulled from the same
+ * (earliest) file an eager parse would have pulled it from.
+ *
+ *  systemCallNames: maps the names of all known system calls to their numbers
+ *  sourceFileNames: the kernel source files, in the order an eager parse would scan them
+ *  indexed: true once sourceFileNames and index have been populated
+ *  index: the locations of the macros for every known system call that has one
+ *  systemCallSignatures: all of the signatures found so far
+ *  resolved: resolved[n] is true once system call n's entry is as complete as it'll ever be
+ *  numUnresolved: the number of entries with names that have yet to be resolved
+ */
+struct systemCallResolver {
+  systemCallResolver() : indexed(false), numUnresolved(0) {}
+  map<string, int> systemCallNames;
+  vector<string> sourceFileNames;
+  bool indexed;
+  systemCallIndex index;
+  map<string, systemCallSignature> systemCallSignatures;
+  vector<bool> resolved;
+  size_t numUnresolved;
+};
+
+/**
+ * Function: resolveFromIndex
+ * --------------------------
+ * Parses the macros the index has for the supplied name, in order, until one of them yields
+ * a signature.  A name that isn't in the index has no signature to find.
+ */
+static void resolveFromIndex(systemCallResolver& resolver, const string& name) {
+  auto found = resolver.index.find(name);
+  if (found == resolver.index.end()) return;
+  for (const pair<size_t, size_t>& location: found->second) {
+    string contents;
+    if (!readEntireFile(resolver.sourceFileNames[location.first], contents) || location.second >= contents.size()) continue;
+    const char *begin = contents.data();
+    const char *cursor = begin + location.second;
+    const char *macroLine;
+    string macro;
+    int numArguments;
+    if (findNextSystemCallMacro(begin, begin + contents.size(), cursor, macro, numArguments, macroLine))
+      processMacroWithLexer(macro, numArguments, resolver.systemCallSignatures, resolver.systemCallNames);
+    if (resolver.systemCallSignatures.find(name) != resolver.systemCallSignatures.end()) return;
+  }
+}
+
+systemCallTable::systemCallTable() : entries(NULL), numEntries(0), names(NULL), mapping(NULL), mappingLength(0) {}
+
+systemCallTable::~systemCallTable() {
+  if (mapping != NULL) munmap(mapping, mappingLength);
+}
+
+void resolveSystemCall(systemCallTable& table, int number) {
+  systemCallResolver *resolver = table.resolver.get();
+  if (resolver == NULL || number < 0 || size_t(number) >= table.numEntries || resolver->resolved[number]) return;
+  resolver->resolved[number] = true;
+  systemCallEntry& entry = table.entryStorage[number];
+  if (entry.nameOffset == 0) return; // nothing to find for numbers without names
+  string name = table.names + entry.nameOffset;
+  if (!resolver->indexed) {
+    listKernelSourceFiles(resolver->sourceFileNames);
+    buildSystemCallIndex(resolver->sourceFileNames, resolver->systemCallNames, resolver->index);
+    resolver->indexed = true;
+  }
+
+  resolveFromIndex(*resolver, name);
+  fillSignature(entry, name, resolver->systemCallSignatures);
+  if (--resolver->numUnresolved > 0) return;
+
+  // every entry has been resolved, so all of the signatures are known and can be cached,
+  // unless none were found (say, because the kernel sources aren't installed), since later
+  // runs would then map the empty cache rather than try the sources again
+  if (!resolver->systemCallSignatures.empty()) cacheSystemCallTable(table);
+  table.resolver.reset();
+}
+
+void compileSystemCallTable(systemCallTable& table, bool rebuild, signatureResolution resolution) {
+  if (table.entries != NULL)
+    throw TraceException("The table supplied to compileSystemCallTable must be empty.");
+  if (!rebuild && mapSystemCallCache(table)) return;
+
+  map<int, string> systemCallNumbers;
+  map<string, int> systemCallNames;
+  map<string, systemCallSignature> systemCallSignatures;
+  collectSystemCallNumbers(systemCallNumbers, systemCallNames);
+  if (resolution == kLazyResolution) {
+    buildSystemCallTable(systemCallNumbers, systemCallSignatures, table);
+    table.resolver.reset(new systemCallResolver);
+    table.resolver->systemCallNames.swap(systemCallNames);
+    table.resolver->resolved.assign(table.numEntries, false);
+    for (const systemCallEntry& entry: table.entryStorage)
+      if (entry.nameOffset != 0) table.resolver->numUnresolved++;
+    return;
+  }
+
   cout << "Extracting system call signature information from " << kKernelSourceCodeDirectory << "..." << endl;
-  cout << "Expect to wait about a minute..... " << flush;
-  processAllKernelSourceFiles(sp, systemCallSignatures, systemCallNames);
-  cacheSignatures(systemCallSignatures);
+  processAllKernelSourceFiles(systemCallSignatures, systemCallNames);
+  buildSystemCallTable(systemCallNumbers, systemCallSignatures, table);
+  if (!systemCallSignatures.empty()) cacheSystemCallTable(table);
   cout << "done!" << endl;
   sleep(2);
 }
@@ -370,13 +950,41 @@ static void collectSystemCallSignatures(map<string, systemCallSignature>& system
  * Function: compileSystemCallData
  * -------------------------------
  * Populates the supplied maps with information about system call numbers, names, and signatures.
- * The implementation just passes the buck on to two helper functions.
+ * The implementation compiles (or maps) the table and then expands it into the three maps.
  */
 void compileSystemCallData(map<int, string>& systemCallNumbers,
                            map<std::string, int>& systemCallNames,
                            map<std::string, systemCallSignature>& systemCallSignatures, bool rebuild) {
   if (systemCallNumbers.size() + systemCallNames.size() + systemCallSignatures.size() > 0)
     throw TraceException("The maps supplied to compileSystemCallData must all be empty.");
-  collectSystemCallNumbers(systemCallNumbers, systemCallNames);
-  collectSystemCallSignatures(systemCallSignatures, systemCallNames, rebuild);
+  systemCallTable table;
+  compileSystemCallTable(table, rebuild);
+  for (size_t number = 0; number < table.numEntries; number++) {
+    const systemCallEntry& entry = table.entries[number];
+    if (entry.nameOffset == 0) continue;
+    string name = table.names + entry.nameOffset;
+    systemCallNumbers[number] = name;
+    systemCallNames[name] = number;
+    if (!entry.hasSignature) continue;
+    systemCallSignature& signature = systemCallSignatures[name];
+    for (size_t i = 0; i < entry.numArguments; i++) signature.push_back(scParamType(entry.parameters[i]));
+  }
+}
+
+const systemCallEntry& lookupSystemCall(const systemCallTable& table, int number) {
+  static const systemCallEntry kUnknownSystemCall = {0, 0, 0, SYSCALL_INTEGER, {}, {}};
+  if (number < 0 || size_t(number) >= table.numEntries) return kUnknownSystemCall;
+  return table.entries[number];
+}
+
+const char *systemCallName(const systemCallTable& table, int number) {
+  if (number < 0 || size_t(number) >= table.numEntries) return "";
+  return table.names + table.entries[number].nameOffset;
+}
+
+int findSystemCallNumber(const systemCallTable& table, const string& name) {
+  for (size_t number = 0; number < table.numEntries; number++) {
+    if (table.entries[number].nameOffset != 0 && name == table.names + table.entries[number].nameOffset) return number;
+  }
+  return -1;
 }
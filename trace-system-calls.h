@@ -8,7 +8,10 @@
 #pragma once
 #include <map>
 #include <vector>
+#include <string>
 #include <ostream>
+#include <cstdint>
+#include <memory>
 
 /**
  * Type: scParamType
@@ -77,8 +80,182 @@ typedef std::vector<scParamType> systemCallSignature;
  *                             "close" -> [SYSCALL_INTEGER]
  *
  * The rebuild boolean, if true, is an instruction to rebuild the map of prototype information from scratch
- * instead of relying on a cached data file.
+ * instead of relying on a cached data file.  The maps are populated from the same table (and the same
+ * binary cache) that compileSystemCallTable below builds.
  */
 void compileSystemCallData(std::map<int, std::string>& systemCallNumbers,
                            std::map<std::string, int>& systemCallNames,
                            std::map<std::string, systemCallSignature>& systemCallSignatures, bool rebuild);
+
+/**
+ * Type: signatureScanner
+ * ----------------------
+ * Identifies one of the two interchangeable strategies for pulling SYSCALL_DEFINE
+ * signatures out of kernel source files: the hand-written lexer (which is what
+ * compileSystemCallData uses) and the original std::regex-based parser (which is kept around
+ * as a reference implementation for testing and benchmarking).
+ */
+enum signatureScanner {
+  kLexerScanner,
+  kRegexScanner
+};
+
+/**
+ * Function: listKernelSourceFiles
+ * -------------------------------
+ * Appends the names of all of the .c files in the Linux kernel source tree to the supplied vector.
+ */
+void listKernelSourceFiles(std::vector<std::string>& sourceFileNames);
+
+/**
+ * Function: collectSignaturesFromKernelSourceFile
+ * -----------------------------------------------
+ * Parses the named kernel source file with the specified scanner, adding a signature to
+ * systemCallSignatures for each SYSCALL_DEFINE macro that names a system call in systemCallNames
+ * and isn't already present in systemCallSignatures.
+ */
+void collectSignaturesFromKernelSourceFile(const std::string& sourceFileName,
+                                           const std::map<std::string, int>& systemCallNames,
+                                           std::map<std::string, systemCallSignature>& systemCallSignatures,
+                                           signatureScanner scanner = kLexerScanner);
+
+/**
+ * Constant: kMaxSystemCallArguments
+ * ---------------------------------
+ * x86_64 system calls accept at most six arguments, all passed in registers.
+ */
+static const size_t kMaxSystemCallArguments = 6;
+
+/**
+ * Type: systemCallEntry
+ * ---------------------
+ * Bundles everything trace needs to know about a single system call number so it can
+ * be printed without any map lookups or allocations.  Entries contain no pointers and
+ * have a fixed layout, so they can be written to and mapped back in from the signature
+ * cache byte for byte.
+ *
+ *  nameOffset: the offset of the system call's '\0'-terminated name within the table's
+ *              names (0, the empty name, if no system call is known by this number)
+ *  hasSignature: nonzero if and only if a signature was found for the system call
+ *  numArguments: the number of meaningful entries within parameters
+ *  returnType: SYSCALL_POINTER for system calls (e.g. brk and mmap) that return an address,
+ *              and SYSCALL_INTEGER for everything else
+ *  parameters: the signature of the system call, inlined, with each scParamType stored in a byte
+ */
+struct systemCallEntry {
+  uint32_t nameOffset;
+  uint8_t hasSignature;
+  uint8_t numArguments;
+  uint8_t returnType;
+  uint8_t parameters[kMaxSystemCallArguments];
+  uint8_t reserved[3];
+};
+
+/**
+ * Type: systemCallTable
+ * ---------------------
+ * A dense, immutable table of systemCallEntry records indexed by system call number, along
+ * with the character storage holding their names.  A table is either compiled in memory, in
+ * which case entries and names point into entryStorage and nameStorage, or mapped from the
+ * signature cache, in which case they point directly into the mapping, or loaded from the
+ * arrays compiled into the executable (see trace-static-tables.h).  Either way, the
+ * table must outlive any pointers pulled from it, and it can't be copied.  Use lookupSystemCall
+ * and systemCallName to access entries.
+ *
+ * A table compiled with kLazyResolution also carries a resolver, which fills in signatures
+ * as resolveSystemCall is called on them, and which is discarded once every signature is known.
+ */
+struct systemCallResolver;
+struct systemCallTable {
+  systemCallTable();
+  ~systemCallTable();
+
+  const systemCallEntry *entries;
+  size_t numEntries;
+  const char *names;
+
+  std::vector<systemCallEntry> entryStorage;
+  std::vector<char> nameStorage;
+  void *mapping;
+  size_t mappingLength;
+  std::unique_ptr<systemCallResolver> resolver;
+
+private:
+  systemCallTable(const systemCallTable& other) = delete;
+  systemCallTable& operator=(const systemCallTable& other) = delete;
+};
+
+/**
+ * Type: signatureResolution
+ * -------------------------
+ * Determines when compileSystemCallTable parses the kernel sources, should it need to:
+ * all at once, up front (kEagerResolution), or bit by bit, as resolveSystemCall asks
+ * for the signatures of system calls actually made (kLazyResolution).
+ */
+enum signatureResolution {
+  kEagerResolution,
+  kLazyResolution
+};
+
+/**
+ * Function: compileSystemCallTable
+ * --------------------------------
+ * Populates the supplied table, which is expected to be empty.  Unless rebuild is true, the
+ * table is mapped in place from the binary signature cache, which is used as is provided its
+ * header identifies the current cache format, carries a hash matching the system header
+ * the system call numbers come from, and holds at least one signature.  Otherwise (or if the
+ * cache is missing or stale) the system header is parsed to learn all of the system call
+ * numbers and names, and then:
+ *
+ *   with kEagerResolution, the kernel sources are parsed for all signatures and the cache is
+ *        rewritten, provided they yielded at least one signature
+ *   with kLazyResolution, the table is returned without any signatures, and each one is
+ *        found only when resolveSystemCall first asks for it.  The cache is written if
+ *        and when every system call's signature has been asked for, provided at least one
+ *        was found.
+ *
+ * trace only calls this when asked to rebuild or when the generated static table (see
+ * trace-static-tables.h) is empty, so it's a fallback rather than the usual path.
+ */
+void compileSystemCallTable(systemCallTable& table, bool rebuild,
+                            signatureResolution resolution = kEagerResolution);
+
+/**
+ * Function: resolveSystemCall
+ * ---------------------------
+ * Ensures that the entry for the supplied system call number carries its signature.  This is
+ * a no-op unless the table was compiled with kLazyResolution and had to go to the kernel sources.
+ * In that case, the very first call lists the kernel sources and indexes them, recording where
+ * each system call's SYSCALL_DEFINE macro is.  That takes a pass over every source file (spread
+ * across all CPUs), which costs nearly as much as an eager parse, and it's paid by whichever
+ * system call happens to come first.  Every call after that (the first for each number, anyway)
+ * reads just the one file the index points to, and parses just the one macro, to find the same
+ * signature an eager parse would.  Must be called before lookupSystemCall for any table that
+ * might be lazy.  Not thread-safe.
+ */
+void resolveSystemCall(systemCallTable& table, int number);
+
+/**
+ * Function: lookupSystemCall
+ * --------------------------
+ * Returns the entry for the supplied system call number with a single bounds-checked
+ * array access.  Numbers beyond the end of the table map to an entry with an empty
+ * name and no arguments.
+ */
+const systemCallEntry& lookupSystemCall(const systemCallTable& table, int number);
+
+/**
+ * Function: systemCallName
+ * ------------------------
+ * Returns the name of the system call with the supplied number, or the empty string
+ * if there's no such system call.
+ */
+const char *systemCallName(const systemCallTable& table, int number);
+
+/**
+ * Function: findSystemCallNumber
+ * ------------------------------
+ * Returns the number of the system call with the supplied name, or -1 if there's no
+ * such system call.
+ */
+int findSystemCallNumber(const systemCallTable& table, const std::string& name);
@@ -8,6 +8,10 @@
  *    + the name of the system call,
  *    + the values of all of its arguments, and
  *    + the system calls return value
+ *
+ * trace follows every process and thread the traced program creates via fork, vfork, and clone.
+ * All tracees are multiplexed through a single waitpid(-1, ..., __WALL) loop, and whenever more than
+ * one is being traced, each line is prefixed with the id of the thread that made the system call.
  */
 
 #include <cassert>
@@ -15,125 +19,323 @@
 #include <stdio.h>
 #include <string.h>
 #include <map>
+#include <vector>
+#include <algorithm>
 #include <set>
+#include <unordered_map>
+#include <cerrno>
 #include <unistd.h> // for fork, execvp
+#include <fcntl.h>  // for open
+#include <ctime>    // for clock_gettime
+#include <signal.h> // for sigprocmask, sigtimedwait
 #include <string.h> // for memchr, strerror
 #include <sys/ptrace.h>
-#include <sys/reg.h>
+#include <sys/user.h> // for user_regs_struct
 #include <sys/wait.h>
 #include "trace-options.h"
 #include "trace-error-constants.h"
 #include "trace-system-calls.h"
 #include "trace-exception.h"
+#include "trace-memory.h"
+#include "trace-output.h"
+#include "trace-record.h"
+#include "trace-format.h"
+#include "trace-filter.h"
+#include "trace-summary.h"
+#include "trace-static-tables.h"
 #include "fork-utils.h" // this has to be the last #include statement in this file
 using namespace std;
 
-std::map <int, string> systemCallNumbers;
-std::map <string, int> systemCallNames;
-std::map<string, systemCallSignature> systemCallSignatures;
 static std::map<int, std::string> errorConstants;
-static int registers[] = {RDI, RSI, RDX, R10, R8, R9};
+static systemCallTable systemCalls;
 
-static string readString(pid_t pid, unsigned long addr) { // addr is a char * read from an argument register via PTRACE_PEEKUSER
-  string str; // start out empty
-  size_t numBytesRead = 0;
-  while (true) {
-    long ret = ptrace(PTRACE_PEEKDATA, pid, addr + numBytesRead);
-    const char* forward = reinterpret_cast<char * const>(&ret);
-    unsigned i;
-    numBytesRead += sizeof(long);
-    for (i = 0; i < sizeof(long) && *(forward + i) != '\0'; i++) str += *(forward + i);
-    if (i != sizeof(long)) return str;
-  }
+/**
+ * Constant: registers
+ * -------------------
+ * Identifies, in order, the user_regs_struct fields that carry the first six arguments
+ * of an x86_64 system call.
+ */
+static unsigned long long user_regs_struct::* const registers[] = {
+  &user_regs_struct::rdi, &user_regs_struct::rsi, &user_regs_struct::rdx,
+  &user_regs_struct::r10, &user_regs_struct::r8, &user_regs_struct::r9
+};
 
-  return str;
+/**
+ * Function: readRegisters
+ * -----------------------
+ * Takes a snapshot of all of the tracee's general purpose registers with a single
+ * PTRACE_GETREGS call, so that everything printed for a stop is derived from one ptrace
+ * request instead of one PTRACE_PEEKUSER per register.
+ */
+static void readRegisters(pid_t pid, user_regs_struct& regs) {
+  ptrace(PTRACE_GETREGS, pid, 0, &regs);
 }
 
-void enterSysCall(pid_t pid, long& retval, bool simple, string& sysCallNumber) {
+/**
+ * Function: currentTimestamp
+ * --------------------------
+ * Returns the number of nanoseconds since the epoch.
+ */
+static uint64_t currentTimestamp() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
 
-  int num = ptrace(PTRACE_PEEKUSER, pid, ORIG_RAX * sizeof(long));
-  if (simple) {
-    cout <<  "syscall(" << num << ") ";
-  } else {
-    sysCallNumber = systemCallNumbers[num];
-    cout << sysCallNumber << "(";
-
-    std::vector<scParamType> signatures =  systemCallSignatures[sysCallNumber];
-    std::vector<scParamType>::iterator iter;
-    for (iter = signatures.begin(); iter != signatures.end(); iter++) {
-      unsigned index = iter - signatures.begin();
-      enum scParamType signature = *iter;
-      assert(signature != SYSCALL_UNKNOWN_TYPE);
-
-      switch(signature) {
-
-      case SYSCALL_INTEGER:
-	cout << ptrace(PTRACE_PEEKUSER, pid, registers[index] * sizeof(long));
-	break;
-      case SYSCALL_STRING: {
-	unsigned long retval = ptrace(PTRACE_PEEKUSER, pid, registers[index] * sizeof(long));
-	string str = readString(pid, retval);
-	cout << "\"" << str << "\"";
-	break;
-      }
-      default: { 
-	long retval = ptrace(PTRACE_PEEKUSER, pid, registers[index] * sizeof(long));
-	(retval == 0) ? (cout << "NULL") :  (cout << "0x" << std::hex << retval << std::dec);
-	break;
-      }
+/**
+ * Function: monotonicNanoseconds
+ * ------------------------------
+ * Returns the current reading of the monotonic clock, which is what system call latencies
+ * are measured against.
+ */
+static uint64_t monotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
 
-      }
-      (iter != signatures.end() - 1) ? (cout << ", ") : (cout <<  ") ");
-    }
+/**
+ * Type: tracee
+ * ------------
+ * The state trace maintains for each thread it's tracing.
+ *
+ *  inSystemCall: true if the thread's most recent syscall stop was an entry stop
+ *  awaitingInitialStop: true until the SIGSTOP that every newly cloned tracee starts with is
+ *                       absorbed, so that it's not delivered once the thread is resumed
+ *  event: the system call in progress, as captured at the entry stop
+ *  entered: the monotonic time of the entry stop (only tracked under --summary)
+ */
+struct tracee {
+  tracee() : inSystemCall(false), awaitingInitialStop(true), entered(0) {}
+  bool inSystemCall;
+  bool awaitingInitialStop;
+  traceEvent event;
+  uint64_t entered;
+};
+
+static unordered_map<pid_t, tracee> tracees;
+static TraceSummary summary;
 
-    if(num == systemCallNames["exit_group"]) retval = ptrace(PTRACE_PEEKUSER, pid, registers[0] * sizeof(long));
+static void enterSysCall(pid_t tid, const user_regs_struct& regs, const traceOptions& options, traceEvent& event) {
+  event.timestamp = currentTimestamp();
+  event.pid = tid;
+  event.number = regs.orig_rax;
+  event.returned = false;
+  resolveSystemCall(systemCalls, event.number);
+  const systemCallEntry& entry = lookupSystemCall(systemCalls, event.number);
+  for (size_t index = 0; index < kMaxSystemCallArguments; index++) {
+    event.args[index] = regs.*registers[index];
+    event.captured[index] = kNotCaptured;
+    if (options.simple || options.summary || index >= entry.numArguments || entry.parameters[index] != SYSCALL_STRING) continue;
+    bool truncated;
+    event.strings[index] = readRemoteString(tid, event.args[index], options.maxStringLength, truncated);
+    event.captured[index] = truncated ? kTruncated : kCaptured;
   }
 }
 
-void exitSysCall(pid_t pid, bool simple, string sysCallNumber) {
-  long ret = ptrace(PTRACE_PEEKUSER, pid, RAX * sizeof(long));
-  cout << "= ";
-  if (simple) {
-    cout << ret << endl;
+/**
+ * Function: publishSysCall
+ * ------------------------
+ * Publishes a complete system call, or one that never returned because its thread exited.
+ * Each system call is published all at once as its thread leaves it, so that lines from
+ * different threads never interleave.
+ */
+static void publishSysCall(const traceOptions& options, traceEvent& event, TraceOutput& out) {
+  if (options.summary) {
+    if (!event.returned) summary.recordUnfinishedSystemCall(event.number);
     return;
   }
-  if (ret < 0) {
-    cout << "-1"  << " " << errorConstants[abs(ret)] << " (" << strerror(abs(ret)) << ")"  << endl;
+
+  event.concurrent = tracees.size() > 1;
+  if (options.binary) {
+    writeTraceEvent(out, event);
     return;
   }
 
-  if (sysCallNumber.compare("brk") == 0
-      || sysCallNumber.compare("sbrk") == 0
-      || sysCallNumber.compare("mmap") == 0) {
+  if (event.concurrent) printThreadPrefix(out, event.pid);
+  printSystemCall(out, event, systemCalls, options.simple);
+  if (event.returned) {
+    printSystemCallReturn(out, event, systemCalls, options.simple, errorConstants);
+  } else {
+    out.put("= <no return>").endLine();
+  }
+}
 
-    cout << "0x" << std::hex << ret << std::dec << endl;
+static void exitSysCall(const user_regs_struct& regs, const traceOptions& options, tracee& t, TraceOutput& out) {
+  t.event.returned = true;
+  t.event.retval = regs.rax;
+  if (options.summary) {
+    summary.recordSystemCall(t.event.number, t.event.retval, monotonicNanoseconds() - t.entered);
     return;
   }
+  publishSysCall(options, t.event, out);
+}
 
-  cout << ret << endl; 
+/**
+ * Function: handleTraceeExit
+ * --------------------------
+ * Publishes the system call the exiting thread was in the middle of (if any), forgets
+ * about the thread, and reports the exit status if it's the process trace launched.
+ */
+static void handleTraceeExit(pid_t tid, int status, pid_t root, const traceOptions& options, TraceOutput& out) {
+  auto found = tracees.find(tid);
+  if (found == tracees.end()) return;
+  if (found->second.inSystemCall) publishSysCall(options, found->second.event, out);
+  tracees.erase(found);
+  if (tid != root) return;
+  if (options.binary && !options.summary) {
+    writeTraceExit(out, tid, currentTimestamp(), status);
+  } else {
+    printProcessExit(out, status);
+  }
 }
 
+/**
+ * Function: handleTraceeStop
+ * --------------------------
+ * Processes a single ptrace stop reported for the supplied thread, and resumes it.  Syscall
+ * stops alternate between entry and exit for each thread independently.  fork, vfork, and
+ * clone event stops introduce new tracees, which the kernel attaches automatically.  Ordinary
+ * signals are delivered to the tracee when it's resumed.
+ *
+ * When trace is running with --filter, the seccomp filter stops the tracee (with a
+ * PTRACE_EVENT_SECCOMP stop) just before each system call of interest, and that stop stands
+ * in for the syscall entry stop.  The tracee is then resumed with PTRACE_SYSCALL so that the
+ * matching exit stop is reported, and with PTRACE_CONT everywhere else, so that all other
+ * system calls run without stopping.
+ */
+static void handleTraceeStop(pid_t tid, int status, const traceOptions& options, TraceOutput& out) {
+  tracee& t = tracees[tid];
+  int sig = WSTOPSIG(status);
+  int event = status >> 16;
+  int deliver = 0;
+  if (event == PTRACE_EVENT_SECCOMP) {
+    user_regs_struct regs;
+    readRegisters(tid, regs);
+    enterSysCall(tid, regs, options, t.event);
+    if (options.summary) t.entered = monotonicNanoseconds();
+    t.inSystemCall = true;
+  } else if (sig == (SIGTRAP | 0x80)) {
+    user_regs_struct regs;
+    readRegisters(tid, regs);
+    if (!t.inSystemCall) {
+      enterSysCall(tid, regs, options, t.event);
+      if (options.summary) t.entered = monotonicNanoseconds();
+    } else {
+      exitSysCall(regs, options, t, out);
+    }
+    t.inSystemCall = !t.inSystemCall;
+  } else if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE) {
+    unsigned long child;
+    ptrace(PTRACE_GETEVENTMSG, tid, 0, &child);
+    tracees[child]; // its initial SIGSTOP may not have been reported yet
+  } else if (event == PTRACE_EVENT_EXEC) {
+    unsigned long former;
+    ptrace(PTRACE_GETEVENTMSG, tid, 0, &former);
+    if (pid_t(former) != tid) { // a non-leader thread called execve and assumed the leader's id
+      auto found = tracees.find(former);
+      if (found != tracees.end()) {
+        t.inSystemCall = found->second.inSystemCall;
+        t.event = found->second.event;
+        t.event.pid = tid;
+        tracees.erase(found);
+      }
+    }
+  } else if (sig == SIGSTOP && t.awaitingInitialStop) {
+    // absorb the SIGSTOP every new tracee starts out with
+  } else if (event == 0 && sig != SIGTRAP) {
+    deliver = sig;
+  }
+
+  t.awaitingInitialStop = false;
+  bool stopAtNextSystemCall = options.filter.empty() || t.inSystemCall;
+  ptrace(stopAtNextSystemCall ? PTRACE_SYSCALL : PTRACE_CONT, tid, 0, deliver);
+}
+
+/**
+ * Function: resolveFilter
+ * -----------------------
+ * Maps the system call names supplied via --filter to their numbers.
+ */
+static vector<int> resolveFilter(const traceOptions& options) {
+  vector<int> numbers;
+  for (const string& name: options.filter) {
+    int number = findSystemCallNumber(systemCalls, name);
+    if (number == -1) throw TraceException("Unknown system call name supplied to --filter (" + name + ")");
+    if (find(numbers.begin(), numbers.end(), number) == numbers.end()) numbers.push_back(number);
+  }
+  if (numbers.size() > kMaxFilteredSystemCalls) throw TraceException("Too many system call names supplied to --filter");
+  return numbers;
+}
+
+/**
+ * Function: openOutput
+ * --------------------
+ * Returns the descriptor trace output should be published to: the file named via --output
+ * if there is one, and standard output otherwise.
+ */
+static int openOutput(const traceOptions& options) {
+  if (options.outputFile.empty()) return STDOUT_FILENO;
+  int fd = open(options.outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) throw TraceException("Failed to open the file named \"" + options.outputFile + "\".");
+  return fd;
+}
+
+/**
+ * Function: waitForTracee
+ * -----------------------
+ * Waits for the next tracee to stop or exit, as waitpid(-1, &status, __WALL) does.  If output is
+ * buffered, though, the wait is capped (SIGCHLD is blocked, and every tracee stop raises it, so
+ * sigtimedwait serves as a waitpid with a timeout) so that the output can be flushed once it's
+ * gone stale, even while every tracee is blocked in a long system call.  Output isn't flushed
+ * just because nothing happens to be ready, since that's the usual state of affairs and would
+ * defeat kFlushBlock.
+ */
+static pid_t waitForTracee(int& status, TraceOutput& out) {
+  sigset_t childMask;
+  sigemptyset(&childMask);
+  sigaddset(&childMask, SIGCHLD);
+  while (true) {
+    pid_t tid = waitpid(-1, &status, __WALL | WNOHANG);
+    if (tid != 0) return tid;
+    int timeout = out.millisecondsUntilFlushDue();
+    if (timeout == -1) return waitpid(-1, &status, __WALL);
+    if (timeout == 0) {
+      out.flush();
+      continue;
+    }
+    struct timespec wait = {timeout / 1000, (timeout % 1000) * 1000000L};
+    sigtimedwait(&childMask, NULL, &wait);
+  }
+}
 
 int main(int argc, char *argv[]) {
-  bool simple = false, rebuild = false;
-  int numFlags = processCommandLineFlags(simple, rebuild, argv);
+  traceOptions options;
+  int numFlags = processCommandLineFlags(options, argv);
   if (argc - numFlags == 1) {
     cout << "Nothing to trace... exiting." << endl;
     return 0;
   }
 
-  compileSystemCallData(systemCallNumbers, systemCallNames, systemCallSignatures, rebuild);
+  if (options.rebuild || !loadStaticSystemCallTable(systemCalls))
+    compileSystemCallTable(systemCalls, options.rebuild, options.rebuild ? kEagerResolution : kLazyResolution);
 
   try {
-    compileSystemCallErrorStrings(errorConstants);
+    if (options.rebuild || !loadStaticErrorConstants(errorConstants))
+      compileSystemCallErrorStrings(errorConstants);
   } catch (MissingFileException& e) {
     std::cout << e.what() << endl;
   }
   
+  vector<int> filter = resolveFilter(options);
   pid_t pid = fork();
   if (pid == 0) {
     ptrace(PTRACE_TRACEME);
     raise(SIGSTOP);
+    if (!filter.empty() && !installSystemCallFilter(filter)) {
+      cerr << "Failed to install the seccomp filter needed by --filter." << endl;
+      _exit(1);
+    }
     execvp(argv[numFlags + 1], argv + numFlags + 1);
     return 0;
   }
@@ -141,42 +343,33 @@ int main(int argc, char *argv[]) {
   int status;
   waitpid(pid, &status, 0);
   assert(WIFSTOPPED(status));
-  ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD);
-
-  ptrace(PTRACE_SYSCALL, pid, 0, 0);
+  ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
+                                    PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL |
+                                    PTRACE_O_TRACESECCOMP);
+  tracees[pid].awaitingInitialStop = false;
+  ptrace(filter.empty() ? PTRACE_SYSCALL : PTRACE_CONT, pid, 0, 0);
+  sigset_t childMask;
+  sigemptyset(&childMask);
+  sigaddset(&childMask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &childMask, NULL); // for waitForTracee; blocked only now so the tracee doesn't inherit it
   
-  long retval = 0;
+  TraceOutput out(openOutput(options), options.flush);
+  if (options.binary && !options.summary) writeTraceFileHeader(out);
   while (true) {
-    //ptrace(PTRACE_SYSCALL, pid, 0, 0);
-    int status;
-    waitpid(pid, &status, 0);
-
-    if(WIFEXITED(status) || WIFSIGNALED(status)) break;
-
-    if(WIFSTOPPED(status)) {
-      if (WSTOPSIG(status) == (SIGTRAP|0x80)) {
-	string sysCallNumber = "";
-	enterSysCall(pid, retval, simple, sysCallNumber);
-	ptrace(PTRACE_SYSCALL, pid, 0, 0);
-
-	int status1;
-	waitpid(pid, &status1, WUNTRACED);
-
-	ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD);
-
-	if(WIFEXITED(status1) || WIFSIGNALED(status1)) break;
+    pid_t tid = waitForTracee(status, out);
+    if (tid == -1) {
+      if (errno == EINTR) continue;
+      break; // ECHILD: nothing left to trace
+    }
 
-	if(WIFSTOPPED(status1)) {
-	  if(WSTOPSIG(status1) == (SIGTRAP|0x80))
-	    exitSysCall(pid, simple, sysCallNumber);
-        ptrace(PTRACE_SYSCALL, pid, 0, 0);
-	}
-      }
-      ptrace(PTRACE_SYSCALL, pid, 0, 0);
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+      handleTraceeExit(tid, status, pid, options, out);
+    } else if (WIFSTOPPED(status)) {
+      handleTraceeStop(tid, status, options, out);
     }
   }
-  cout << "= <no return>" << endl;
-  cout << "Program exited normally with status " << retval << endl;
+  if (options.summary) summary.print(out, systemCalls, errorConstants);
+  out.flush();
 
   return 0;
 }